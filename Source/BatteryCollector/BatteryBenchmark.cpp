@@ -0,0 +1,231 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BatteryCollector.h"
+#include "BatteryBenchmark.h"
+#include "RenderCore.h"
+#include "Kismet/GameplayStatics.h"
+#include "BatteryCollectorGameMode.h"
+#include "BatteryCollectorCharacter.h"
+#include "BatteryBotController.h"
+
+
+ABatteryBenchmarkDirector::ABatteryBenchmarkDirector()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	//Sample once everything else has run this frame
+	PrimaryActorTick.TickGroup = TG_PostUpdateWork;
+
+	m_botCount = 16;
+	m_duration = 60.0f;
+	m_seed = 1;
+
+	m_elapsed = 0.0f;
+	m_bFinished = false;
+	m_secondFrames = 0;
+	m_secondGameThreadMs = 0.0f;
+	m_lastSpawned = 0;
+	m_lastCollected = 0;
+	m_peakLiveActors = 0;
+
+	m_gcStart = 0.0;
+	m_gcTotalSeconds = 0.0;
+	m_gcMaxSeconds = 0.0;
+	m_gcCount = 0;
+}
+
+bool ABatteryBenchmarkDirector::IsBenchmarkRun() {
+	return FParse::Param(FCommandLine::Get(), TEXT("BatteryBench"));
+}
+
+void ABatteryBenchmarkDirector::BeginPlay() {
+
+	Super::BeginPlay();
+
+	const TCHAR* const commandLine = FCommandLine::Get();
+	int32 fps = 30;
+	FParse::Value(commandLine, TEXT("BenchBots="), m_botCount);
+	FParse::Value(commandLine, TEXT("BenchDuration="), m_duration);
+	FParse::Value(commandLine, TEXT("BenchFPS="), fps);
+	FParse::Value(commandLine, TEXT("BenchSeed="), m_seed);
+	if(!FParse::Value(commandLine, TEXT("BenchReport="), m_reportName)) {
+		m_reportName = FString::Printf(TEXT("BatteryBench-%s"), *FDateTime::Now().ToString());
+	}
+
+	//Every run simulates the same amount of game time per frame whatever the machine
+	FApp::SetUseFixedTimeStep(true);
+	FApp::SetFixedDeltaTime(1.0 / FMath::Max(fps, 1));
+
+	m_preGCHandle = FCoreUObjectDelegates::PreGarbageCollect.AddUObject(this, &ABatteryBenchmarkDirector::OnPreGarbageCollect);
+	m_postGCHandle = FCoreUObjectDelegates::PostGarbageCollect.AddUObject(this, &ABatteryBenchmarkDirector::OnPostGarbageCollect);
+
+	//Keep the match running for the whole benchmark
+	ABatteryCollectorGameMode* const gameMode = GetWorld()->GetAuthGameMode<ABatteryCollectorGameMode>();
+	ABatteryCollectorCharacter* const player = Cast<ABatteryCollectorCharacter>(UGameplayStatics::GetPlayerPawn(this, 0));
+	if(gameMode && player) {
+		player->SetPowerDecayRate(0.0f);
+		gameMode->OnCharacterPowerChanged(player);
+	}
+
+	m_frameTimes.Reserve(FMath::CeilToInt(m_duration * fps) + 1);
+
+	SpawnBots();
+
+	UE_LOG(LogClass, Log, TEXT("BatteryBench: %d bots, %.0f s at %d fps"), m_botCount, m_duration, fps);
+
+}
+
+void ABatteryBenchmarkDirector::EndPlay(const EEndPlayReason::Type EndPlayReason) {
+
+	FCoreUObjectDelegates::PreGarbageCollect.Remove(m_preGCHandle);
+	FCoreUObjectDelegates::PostGarbageCollect.Remove(m_postGCHandle);
+
+	Super::EndPlay(EndPlayReason);
+
+}
+
+void ABatteryBenchmarkDirector::Tick(float DeltaTime) {
+
+	Super::Tick(DeltaTime);
+
+	if(m_bFinished) {
+		return;
+	}
+
+	//Game thread time of the last completed frame
+	const float gameThreadMs = FPlatformTime::ToMilliseconds(GGameThreadTime);
+	m_frameTimes.Add(gameThreadMs);
+	m_secondFrames++;
+	m_secondGameThreadMs += gameThreadMs;
+
+	const int32 liveActors = GetWorld()->GetActorCount();
+	m_peakLiveActors = FMath::Max(m_peakLiveActors, liveActors);
+
+	const int32 previousSecond = FMath::FloorToInt(m_elapsed);
+	m_elapsed += DeltaTime;
+
+	//Close off a row of the timeline every simulated second
+	if(FMath::FloorToInt(m_elapsed) > previousSecond) {
+		ABatteryCollectorGameMode* const gameMode = GetWorld()->GetAuthGameMode<ABatteryCollectorGameMode>();
+
+		FBenchSecond second;
+		second.time = m_elapsed;
+		second.frames = m_secondFrames;
+		second.gameThreadMs = m_secondGameThreadMs / FMath::Max(m_secondFrames, 1);
+		second.liveActors = liveActors;
+		second.livePickups = gameMode ? gameMode->GetActivePickupCount() : 0;
+		second.spawned = gameMode ? gameMode->GetPickupsSpawned() - m_lastSpawned : 0;
+		second.collected = gameMode ? gameMode->GetPickupsCollected() - m_lastCollected : 0;
+		m_seconds.Add(second);
+
+		m_lastSpawned += second.spawned;
+		m_lastCollected += second.collected;
+		m_secondFrames = 0;
+		m_secondGameThreadMs = 0.0f;
+	}
+
+	if(m_elapsed >= m_duration) {
+		FinishRun();
+	}
+
+}
+
+void ABatteryBenchmarkDirector::SpawnBots() {
+
+	AGameModeBase* const gameMode = GetWorld()->GetAuthGameMode();
+	APawn* const player = UGameplayStatics::GetPlayerPawn(this, 0);
+	if(gameMode == nullptr || gameMode->DefaultPawnClass == NULL) {
+		return;
+	}
+
+	const FVector origin = player ? player->GetActorLocation() : GetActorLocation();
+	FRandomStream random(m_seed);
+
+	FActorSpawnParameters spawnParams;
+	spawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButDontSpawnIfColliding;
+
+	for(int32 iBot = 0; iBot < m_botCount; iBot++) {
+		//Scatter the bots on a ring around the player
+		const FVector offset = FRotator(0.0f, random.FRandRange(0.0f, 360.0f), 0.0f).Vector() * random.FRandRange(300.0f, 1500.0f);
+		const FRotator rotation(0.0f, random.FRandRange(0.0f, 360.0f), 0.0f);
+
+		APawn* const bot = GetWorld()->SpawnActor<APawn>(gameMode->DefaultPawnClass, origin + offset, rotation, spawnParams);
+		if(bot == nullptr) {
+			continue;
+		}
+
+		bot->AIControllerClass = ABatteryBotController::StaticClass();
+		bot->SpawnDefaultController();
+
+		ABatteryBotController* const controller = Cast<ABatteryBotController>(bot->GetController());
+		if(controller) {
+			controller->SetRandomSeed(m_seed + iBot);
+		}
+	}
+
+}
+
+void ABatteryBenchmarkDirector::FinishRun() {
+
+	m_bFinished = true;
+
+	ABatteryCollectorGameMode* const gameMode = GetWorld()->GetAuthGameMode<ABatteryCollectorGameMode>();
+	const int32 spawned = gameMode ? gameMode->GetPickupsSpawned() : 0;
+	const int32 collected = gameMode ? gameMode->GetPickupsCollected() : 0;
+	const FPlatformMemoryStats memoryStats = FPlatformMemory::GetStats();
+
+	const FString reportDir = FPaths::ProfilingDir() / TEXT("BatteryBench");
+
+	//Summary
+	FString json = TEXT("{\n");
+	json += FString::Printf(TEXT("\t\"bots\": %d,\n"), m_botCount);
+	json += FString::Printf(TEXT("\t\"simulatedSeconds\": %.3f,\n"), m_elapsed);
+	json += FString::Printf(TEXT("\t\"frames\": %d,\n"), m_frameTimes.Num());
+	json += FString::Printf(TEXT("\t\"gameThreadMs\": { \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f },\n"),
+		GetFrameTimePercentile(0.5f), GetFrameTimePercentile(0.9f), GetFrameTimePercentile(0.99f), GetFrameTimePercentile(1.0f));
+	json += FString::Printf(TEXT("\t\"pickupsSpawned\": %d,\n"), spawned);
+	json += FString::Printf(TEXT("\t\"pickupsCollected\": %d,\n"), collected);
+	json += FString::Printf(TEXT("\t\"pickupsSpawnedPerSecond\": %.3f,\n"), spawned / FMath::Max(m_elapsed, 1.0f));
+	json += FString::Printf(TEXT("\t\"pickupsCollectedPerSecond\": %.3f,\n"), collected / FMath::Max(m_elapsed, 1.0f));
+	json += FString::Printf(TEXT("\t\"peakLiveActors\": %d,\n"), m_peakLiveActors);
+	json += FString::Printf(TEXT("\t\"gc\": { \"count\": %d, \"totalMs\": %.3f, \"maxMs\": %.3f },\n"), m_gcCount, m_gcTotalSeconds * 1000.0, m_gcMaxSeconds * 1000.0);
+	json += FString::Printf(TEXT("\t\"peakUsedPhysicalBytes\": %llu\n"), (uint64)memoryStats.PeakUsedPhysical);
+	json += TEXT("}\n");
+	FFileHelper::SaveStringToFile(json, *(reportDir / m_reportName + TEXT(".json")));
+
+	//Timeline
+	FString csv = TEXT("time,frames,gameThreadMs,liveActors,livePickups,spawned,collected\n");
+	for(const FBenchSecond& second : m_seconds) {
+		csv += FString::Printf(TEXT("%.3f,%d,%.3f,%d,%d,%d,%d\n"), second.time, second.frames, second.gameThreadMs, second.liveActors, second.livePickups, second.spawned, second.collected);
+	}
+	FFileHelper::SaveStringToFile(csv, *(reportDir / m_reportName + TEXT(".csv")));
+
+	UE_LOG(LogClass, Log, TEXT("BatteryBench: finished, report written to %s"), *(reportDir / m_reportName));
+
+	FPlatformMisc::RequestExit(false);
+
+}
+
+float ABatteryBenchmarkDirector::GetFrameTimePercentile(float percentile) const {
+
+	if(m_frameTimes.Num() == 0) {
+		return 0.0f;
+	}
+
+	TArray<float> sorted = m_frameTimes;
+	sorted.Sort();
+
+	const int32 index = FMath::Clamp(FMath::CeilToInt(percentile * sorted.Num()) - 1, 0, sorted.Num() - 1);
+	return sorted[index];
+
+}
+
+void ABatteryBenchmarkDirector::OnPreGarbageCollect() {
+	m_gcStart = FPlatformTime::Seconds();
+}
+
+void ABatteryBenchmarkDirector::OnPostGarbageCollect() {
+	const double gcSeconds = FPlatformTime::Seconds() - m_gcStart;
+	m_gcTotalSeconds += gcSeconds;
+	m_gcMaxSeconds = FMath::Max(m_gcMaxSeconds, gcSeconds);
+	m_gcCount++;
+}
@@ -0,0 +1,86 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "GameFramework/Actor.h"
+#include "BatteryBenchmark.generated.h"
+
+/**
+ * Drives a headless load test. Spawned by the game mode when the game is started with -BatteryBench, e.g.
+ *
+ *   BatteryCollector CollectionLevel -game -nullrhi -nosound -unattended -BatteryBench -BenchBots=64 -BenchDuration=120
+ *
+ * Options: -BenchBots=N collector bots (default 16), -BenchDuration=S simulated seconds (default 60),
+ * -BenchFPS=N fixed timestep (default 30), -BenchSeed=N bot seed (default 1), -BenchReport=Name report file name.
+ * When the duration has been simulated a JSON summary and a per-second CSV are written to Saved/Profiling/BatteryBench
+ * and the game exits.
+ */
+UCLASS()
+class BATTERYCOLLECTOR_API ABatteryBenchmarkDirector : public AActor {
+	GENERATED_BODY()
+
+public:
+	ABatteryBenchmarkDirector();
+
+	//True when the command line asks for a benchmark run
+	static bool IsBenchmarkRun();
+
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	virtual void Tick(float DeltaTime) override;
+
+private:
+	//One row of the per-second CSV
+	struct FBenchSecond {
+		float time;
+		int32 frames;
+		float gameThreadMs;
+		int32 liveActors;
+		int32 livePickups;
+		int32 spawned;
+		int32 collected;
+	};
+
+	//Spawn the collector bots around the player start
+	void SpawnBots();
+
+	//Write the JSON and CSV reports and quit
+	void FinishRun();
+
+	//Value at the given percentile of the frame samples
+	float GetFrameTimePercentile(float percentile) const;
+
+	void OnPreGarbageCollect();
+	void OnPostGarbageCollect();
+
+	int32 m_botCount;
+	float m_duration;
+	int32 m_seed;
+	FString m_reportName;
+
+	float m_elapsed;
+	bool m_bFinished;
+
+	//Game thread time of every frame in milliseconds
+	TArray<float> m_frameTimes;
+
+	TArray<FBenchSecond> m_seconds;
+	int32 m_secondFrames;
+	float m_secondGameThreadMs;
+	int32 m_lastSpawned;
+	int32 m_lastCollected;
+
+	int32 m_peakLiveActors;
+
+	//Garbage collection timing
+	double m_gcStart;
+	double m_gcTotalSeconds;
+	double m_gcMaxSeconds;
+	int32 m_gcCount;
+
+	FDelegateHandle m_preGCHandle;
+	FDelegateHandle m_postGCHandle;
+
+};
@@ -0,0 +1,90 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BatteryCollector.h"
+#include "BatteryBotController.h"
+#include "BatteryCollectorCharacter.h"
+#include "BatteryCollectorGameMode.h"
+
+
+ABatteryBotController::ABatteryBotController()
+{
+	PrimaryActorTick.bCanEverTick = true;
+
+	wanderInterval = 3.0f;
+	collectInterval = 0.5f;
+
+	m_wanderDirection = FVector::ForwardVector;
+	m_timeUntilTurn = 0.0f;
+	m_timeUntilCollect = 0.0f;
+}
+
+void ABatteryBotController::SetRandomSeed(int32 seed) {
+	m_random.Initialize(seed);
+}
+
+void ABatteryBotController::Possess(APawn* InPawn) {
+
+	Super::Possess(InPawn);
+
+	ABatteryCollectorGameMode* const gameMode = GetWorld()->GetAuthGameMode<ABatteryCollectorGameMode>();
+	if(gameMode) {
+		gameMode->GetBotDecisions().AddBot(this, GetWorld()->GetTimeSeconds());
+		SetActorTickEnabled(false);
+	}
+
+}
+
+void ABatteryBotController::UnPossess() {
+
+	ABatteryCollectorGameMode* const gameMode = GetWorld()->GetAuthGameMode<ABatteryCollectorGameMode>();
+	if(gameMode) {
+		gameMode->GetBotDecisions().RemoveBot(this);
+		SetActorTickEnabled(true);
+	}
+
+	Super::UnPossess();
+
+}
+
+void ABatteryBotController::Tick(float DeltaTime) {
+
+	Super::Tick(DeltaTime);
+
+	Steer(nullptr, DeltaTime);
+
+}
+
+void ABatteryBotController::Steer(const FVector* targetLocation, float DeltaTime) {
+
+	ABatteryCollectorCharacter* const bot = Cast<ABatteryCollectorCharacter>(GetPawn());
+	if(bot == nullptr) {
+		return;
+	}
+
+	//Head for the target and collect once it is inside the collection sphere
+	if(targetLocation) {
+		const FVector toTarget = *targetLocation - bot->GetActorLocation();
+		bot->AddMovementInput(toTarget.GetSafeNormal2D(), 1.0f);
+		if(toTarget.SizeSquared2D() <= FMath::Square(bot->GetCollectionSphere()->GetScaledSphereRadius())) {
+			bot->CollectPickups();
+		}
+		return;
+	}
+
+	//Pick a new heading every so often
+	m_timeUntilTurn -= DeltaTime;
+	if(m_timeUntilTurn <= 0.0f) {
+		const float yaw = m_random.FRandRange(0.0f, 360.0f);
+		m_wanderDirection = FRotator(0.0f, yaw, 0.0f).Vector();
+		m_timeUntilTurn = wanderInterval;
+	}
+
+	bot->AddMovementInput(m_wanderDirection, 1.0f);
+
+	m_timeUntilCollect -= DeltaTime;
+	if(m_timeUntilCollect <= 0.0f) {
+		bot->CollectPickups();
+		m_timeUntilCollect = collectInterval;
+	}
+
+}
@@ -0,0 +1,54 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "AIController.h"
+#include "BatteryBotController.generated.h"
+
+/**
+ * Collector bot for filling servers and load testing. With a BatteryCollector game mode it heads for the batteries the
+ * game mode's FBotDecisionSystem picks for it; without one, or with nothing in range, it wanders in a random direction
+ * and tries to collect every so often.
+ */
+UCLASS()
+class BATTERYCOLLECTOR_API ABatteryBotController : public AAIController {
+	GENERATED_BODY()
+
+public:
+	ABatteryBotController();
+
+	//Hand the bot to the game mode's decision system, which steers it from then on
+	virtual void Possess(APawn* InPawn) override;
+	virtual void UnPossess() override;
+
+	//Only ticks while nothing else steers the bot
+	virtual void Tick(float DeltaTime) override;
+
+	/**
+	 * Move the pawn for a frame - game thread
+	 * @param targetLocation	Where to head and collect, null to wander
+	 */
+	void Steer(const FVector* targetLocation, float DeltaTime);
+
+	//Seed the bot's choices so a run can be repeated
+	void SetRandomSeed(int32 seed);
+
+protected:
+	//Seconds between changes of wander direction
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Bot")
+	float wanderInterval;
+
+	//Seconds between collect attempts
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Bot")
+	float collectInterval;
+
+private:
+	FRandomStream m_random;
+
+	FVector m_wanderDirection;
+
+	float m_timeUntilTurn;
+
+	float m_timeUntilCollect;
+
+};
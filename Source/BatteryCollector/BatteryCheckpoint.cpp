@@ -0,0 +1,118 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BatteryCollector.h"
+#include "BatteryCheckpoint.h"
+#include "Async/Async.h"
+
+namespace {
+	const uint32 CheckpointMagic = 0x50434342; // "BCCP"
+	const uint32 CheckpointVersion = 1;
+
+	//Counts go out packed, most levels fit each in a byte or two
+	template<typename T>
+	void SerializeCount(FArchive& archive, TArray<T>& items) {
+		uint32 count = items.Num();
+		archive.SerializeIntPacked(count);
+		if(archive.IsLoading()) {
+			items.SetNumUninitialized(FMath::Min<uint32>(count, archive.TotalSize()));
+		}
+	}
+}
+
+
+bool FBatteryCheckpoint::Serialize(FArchive& archive, FCheckpointData& data) {
+
+	uint32 magic = CheckpointMagic;
+	uint32 version = CheckpointVersion;
+	archive << magic << version;
+	if(magic != CheckpointMagic || version != CheckpointVersion) {
+		return false;
+	}
+
+	archive << data.playState << data.gameTime;
+
+	SerializeCount(archive, data.playerPower);
+	for(float& power : data.playerPower) {
+		archive << power;
+	}
+
+	SerializeCount(archive, data.volumeNames);
+	data.spawnPhases.SetNumZeroed(data.volumeNames.Num());
+	for(int32 iVolume = 0; iVolume < data.volumeNames.Num(); iVolume++) {
+		archive << data.volumeNames[iVolume] << data.spawnPhases[iVolume];
+	}
+
+	SerializeCount(archive, data.pickups);
+	for(FCheckpointPickup& pickup : data.pickups) {
+		uint8 flags = pickup.bActive ? 1 : 0;
+		archive << pickup.volume << pickup.pool << flags << pickup.power << pickup.location;
+
+		//Rotation to about a hundredth of a degree is plenty for a battery lying on the ground
+		uint16 pitch = FRotator::CompressAxisToShort(pickup.rotation.Pitch);
+		uint16 yaw = FRotator::CompressAxisToShort(pickup.rotation.Yaw);
+		uint16 roll = FRotator::CompressAxisToShort(pickup.rotation.Roll);
+		archive << pitch << yaw << roll;
+
+		if(archive.IsLoading()) {
+			pickup.bActive = (flags & 1) != 0;
+			pickup.rotation = FRotator(FRotator::DecompressAxisFromShort(pitch), FRotator::DecompressAxisFromShort(yaw), FRotator::DecompressAxisFromShort(roll));
+		}
+	}
+
+	return !archive.IsError();
+
+}
+
+void FBatteryCheckpoint::SaveAsync(const FString& name, TSharedRef<FCheckpointData, ESPMode::ThreadSafe> data) {
+
+	//The data is a copy, nothing here touches the match
+	Async<void>(EAsyncExecution::ThreadPool, [name, data]() {
+		const double startTime = FPlatformTime::Seconds();
+		const int32 size = Save(name, *data);
+		if(size > 0) {
+			UE_LOG(LogClass, Log, TEXT("Checkpoint %s: %d pickups, %d bytes written in %.2f ms off the game thread"),
+				*name, data->pickups.Num(), size, (FPlatformTime::Seconds() - startTime) * 1000.0);
+		}
+	});
+
+}
+
+int32 FBatteryCheckpoint::Save(const FString& name, FCheckpointData& data) {
+
+	TArray<uint8> bytes;
+	bytes.Reserve(64 + data.playerPower.Num() * 4 + data.volumeNames.Num() * 8 + data.pickups.Num() * 26);
+	FMemoryWriter writer(bytes);
+	Serialize(writer, data);
+
+	if(!FFileHelper::SaveArrayToFile(bytes, *GetCheckpointPath(name))) {
+		UE_LOG(LogClass, Warning, TEXT("Can't write checkpoint %s"), *name);
+		return 0;
+	}
+
+	return bytes.Num();
+
+}
+
+bool FBatteryCheckpoint::Load(const FString& name, FCheckpointData& outData) {
+
+	TArray<uint8> bytes;
+	if(!FFileHelper::LoadFileToArray(bytes, *GetCheckpointPath(name), FILEREAD_Silent)) {
+		UE_LOG(LogClass, Warning, TEXT("No checkpoint %s"), *name);
+		return false;
+	}
+
+	FMemoryReader reader(bytes);
+	if(!Serialize(reader, outData)) {
+		UE_LOG(LogClass, Warning, TEXT("Checkpoint %s is damaged or from another version"), *name);
+		return false;
+	}
+
+	return true;
+
+}
+
+FString FBatteryCheckpoint::GetCheckpointPath(const FString& name) {
+
+	return FPaths::GameSavedDir() / TEXT("Checkpoints") / name + TEXT(".bccp");
+
+}
@@ -0,0 +1,61 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+//A pickup in the level, or a battery drawn as an instance
+struct FCheckpointPickup {
+	//Index of the spawn volume in the checkpoint, and of the pool within it (see ASpawnVolume::GetPoolAt)
+	uint16 volume;
+	uint8 pool;
+	bool bActive;
+	float power;
+	FVector location;
+	FRotator rotation;
+};
+
+//Everything a checkpoint restores, copied off the match on the game thread
+struct FCheckpointData {
+	//eBatteryPlayState
+	uint8 playState;
+	float gameTime;
+
+	//Power of each player, in player controller order
+	TArray<float> playerPower;
+
+	//Spawn volume name hashes, so volumes are matched up by name rather than by the order they were found in
+	TArray<uint32> volumeNames;
+
+	//Seconds until each volume's next spawn, negative when it has none scheduled
+	TArray<float> spawnPhases;
+
+	TArray<FCheckpointPickup> pickups;
+
+	FCheckpointData() : playState(0), gameTime(0.0f) {}
+};
+
+/**
+ * Save and load a running match as a small binary file in Saved/Checkpoints, for crash recovery and for starting
+ * benchmarks from a known busy level.
+ *
+ * Layout: magic, version, play state, game time, then the players, the volumes and the pickups, each as a packed count
+ * followed by the records. A pickup takes 26 bytes: its volume and pool, a flag, its power, its location and its
+ * rotation compressed to three shorts.
+ */
+class BATTERYCOLLECTOR_API FBatteryCheckpoint {
+
+public:
+	//Read or write the whole checkpoint. Returns false if the archive isn't a checkpoint of this version
+	static bool Serialize(FArchive& archive, FCheckpointData& data);
+
+	//Serialize and write the checkpoint on a worker thread, logging how long it took
+	static void SaveAsync(const FString& name, TSharedRef<FCheckpointData, ESPMode::ThreadSafe> data);
+
+	//Serialize and write the checkpoint now. Returns the size written, 0 if it failed
+	static int32 Save(const FString& name, FCheckpointData& data);
+
+	//Read a checkpoint. Returns false if it is missing or not of this version
+	static bool Load(const FString& name, FCheckpointData& outData);
+
+	static FString GetCheckpointPath(const FString& name);
+
+};
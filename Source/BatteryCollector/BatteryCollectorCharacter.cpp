@@ -5,6 +5,31 @@
 #include "BatteryCollectorCharacter.h"
 #include "Pickup.h"
 #include "BatteryPickup.h"
+#include "BatteryCollectorGameMode.h"
+#include "BatteryCollectorStats.h"
+#include "BatteryEventLog.h"
+#include "UnrealNetwork.h"
+
+//////////////////////////////////////////////////////////////////////////
+// FReplicatedPower
+
+bool FReplicatedPower::NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess)
+{
+	uint32 quantizedPower = Ar.IsSaving() ? (uint32)FMath::RoundToInt(FMath::Max(power, 0.0f) * 10.0f) : 0;
+	uint32 quantizedDecay = Ar.IsSaving() ? (uint32)FMath::RoundToInt(FMath::Max(decayPerSecond, 0.0f) * 100.0f) : 0;
+
+	Ar.SerializeIntPacked(quantizedPower);
+	Ar.SerializeIntPacked(quantizedDecay);
+	Ar << timestamp;
+
+	if(Ar.IsLoading()) {
+		power = quantizedPower / 10.0f;
+		decayPerSecond = quantizedDecay / 100.0f;
+	}
+
+	bOutSuccess = true;
+	return true;
+}
 
 //////////////////////////////////////////////////////////////////////////
 // ABatteryCollectorCharacter
@@ -52,9 +77,39 @@ ABatteryCollectorCharacter::ABatteryCollectorCharacter()
 	initialPower = 2000.0f;
 	characterPower = initialPower;
 
+	//Power holds steady until the game mode starts the decay
+	m_powerTimestamp = 0.0f;
+	m_powerDecayRate = 0.0f;
+	powerRefreshInterval = 0.1f;
+	powerReplicationThreshold = 1.0f;
+	collectValidationSlack = 150.0f;
+	bAutoCollect = false;
+	autoCollectBudgetPerFrame = 8;
+	m_nextCollectSequence = 0;
+	m_replicatedPower.power = characterPower;
+
+	m_pendingMoveForward = 0.0f;
+	m_pendingMoveRight = 0.0f;
+	m_pendingTurn = 0.0f;
+	m_pendingLookUp = 0.0f;
+	m_pendingActions = 0;
+	m_bApplyingRecordedInput = false;
+	m_inputRecording = nullptr;
+
 	//Set the dependence of the speed on the power level
 	speedFactor = 0.75f;
 	baseSpeed = 10.0f;
+	walkSpeedEpsilon = 5.0f;
+
+	//Decay only shows once enough has drained, collected batteries always show
+	effectCoalesceWindow = 0.1f;
+	decayEffectThreshold = 25.0f;
+	pickupEffectThreshold = 0.0f;
+	externalEffectThreshold = 0.0f;
+	m_effectPower = characterPower;
+	m_pendingEffectDelta = 0.0f;
+	m_pendingEffectReason = ePowerChangeReason::eDecay;
+	m_bEffectPending = false;
 
 }
 
@@ -65,10 +120,10 @@ void ABatteryCollectorCharacter::SetupPlayerInputComponent(class UInputComponent
 {
 	// Set up gameplay key bindings
 	check(PlayerInputComponent);
-	PlayerInputComponent->BindAction("Jump", IE_Pressed, this, &ACharacter::Jump);
-	PlayerInputComponent->BindAction("Jump", IE_Released, this, &ACharacter::StopJumping);
+	PlayerInputComponent->BindAction("Jump", IE_Pressed, this, &ABatteryCollectorCharacter::OnJumpPressed);
+	PlayerInputComponent->BindAction("Jump", IE_Released, this, &ABatteryCollectorCharacter::OnJumpReleased);
 
-	PlayerInputComponent->BindAction("Collect", IE_Pressed, this, &ABatteryCollectorCharacter::CollectPickups);
+	PlayerInputComponent->BindAction("Collect", IE_Pressed, this, &ABatteryCollectorCharacter::OnCollectPressed);
 
 	PlayerInputComponent->BindAxis("MoveForward", this, &ABatteryCollectorCharacter::MoveForward);
 	PlayerInputComponent->BindAxis("MoveRight", this, &ABatteryCollectorCharacter::MoveRight);
@@ -76,9 +131,9 @@ void ABatteryCollectorCharacter::SetupPlayerInputComponent(class UInputComponent
 	// We have 2 versions of the rotation bindings to handle different kinds of devices differently
 	// "turn" handles devices that provide an absolute delta, such as a mouse.
 	// "turnrate" is for devices that we choose to treat as a rate of change, such as an analog joystick
-	PlayerInputComponent->BindAxis("Turn", this, &APawn::AddControllerYawInput);
+	PlayerInputComponent->BindAxis("Turn", this, &ABatteryCollectorCharacter::Turn);
 	PlayerInputComponent->BindAxis("TurnRate", this, &ABatteryCollectorCharacter::TurnAtRate);
-	PlayerInputComponent->BindAxis("LookUp", this, &APawn::AddControllerPitchInput);
+	PlayerInputComponent->BindAxis("LookUp", this, &ABatteryCollectorCharacter::LookUp);
 	PlayerInputComponent->BindAxis("LookUpRate", this, &ABatteryCollectorCharacter::LookUpAtRate);
 
 	// handle touch devices
@@ -87,48 +142,357 @@ void ABatteryCollectorCharacter::SetupPlayerInputComponent(class UInputComponent
 
 	// VR headset functionality
 	PlayerInputComponent->BindAction("ResetVR", IE_Pressed, this, &ABatteryCollectorCharacter::OnResetVR);
+
+	//The session's recording follows the first player from pawn to pawn, other local players aren't recorded
+	ABatteryCollectorGameMode* const gameMode = GetWorld()->GetAuthGameMode<ABatteryCollectorGameMode>();
+	if(gameMode && GetController() && GetController() == GetWorld()->GetFirstPlayerController()) {
+		m_inputRecording = gameMode->GetInputRecording();
+	}
+}
+
+void ABatteryCollectorCharacter::BeginPlay()
+{
+	Super::BeginPlay();
+
+	CollectionSphere->OnComponentBeginOverlap.AddDynamic(this, &ABatteryCollectorCharacter::OnCollectionSphereBeginOverlap);
+	CollectionSphere->OnComponentEndOverlap.AddDynamic(this, &ABatteryCollectorCharacter::OnCollectionSphereEndOverlap);
+
+	//Whatever is in reach already, from here on the overlap events keep the candidates up to date
+	TArray<AActor*> overlappingActors;
+	CollectionSphere->GetOverlappingActors(overlappingActors, APickup::StaticClass());
+	for(AActor* const actor : overlappingActors) {
+		m_collectCandidates.Add(Cast<APickup>(actor));
+	}
+}
+
+void ABatteryCollectorCharacter::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	//Whoever controls the character collects - the server for itself and bots, clients predict for their own
+	if(bAutoCollect && m_collectCandidates.Num() > 0 && IsLocallyControlled()) {
+		if(Role == ROLE_Authority) {
+			CollectCandidates(autoCollectBudgetPerFrame);
+		} else {
+			PredictCollectPickups(autoCollectBudgetPerFrame);
+		}
+	}
+
+	if(m_inputRecording == nullptr || !m_inputRecording->IsActive()) {
+		return;
+	}
+
+	FRecordedInputFrame frame;
+	if(m_inputRecording->GetMode() == FInputRecording::eMode::eRecording) {
+		//Quantize first so the recording run sees exactly what a replay will
+		frame.moveForward = FRecordedInputFrame::QuantizeAxis(m_pendingMoveForward);
+		frame.moveRight = FRecordedInputFrame::QuantizeAxis(m_pendingMoveRight);
+		frame.turn = m_pendingTurn;
+		frame.lookUp = m_pendingLookUp;
+		frame.actions = m_pendingActions;
+		m_inputRecording->WriteFrame(frame);
+
+		m_pendingMoveForward = 0.0f;
+		m_pendingMoveRight = 0.0f;
+		m_pendingTurn = 0.0f;
+		m_pendingLookUp = 0.0f;
+		m_pendingActions = 0;
+	} else if(!m_inputRecording->ReadFrame(frame)) {
+		m_inputRecording->Close();
+		//Headless replays are done once the input runs out
+		if(FApp::IsUnattended()) {
+			FPlatformMisc::RequestExit(false);
+		}
+		return;
+	}
+
+	ApplyInputFrame(frame);
+}
+
+void ABatteryCollectorCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	//The recording belongs to the game mode and carries on with the next pawn
+	m_inputRecording = nullptr;
+
+	//Stop counting towards the match
+	ABatteryCollectorGameMode* const gameMode = GetWorld()->GetAuthGameMode<ABatteryCollectorGameMode>();
+	if(gameMode) {
+		gameMode->RemovePlayer(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ABatteryCollectorCharacter::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(ABatteryCollectorCharacter, m_replicatedPower);
+}
+
+bool ABatteryCollectorCharacter::IsInputRouted() const
+{
+	return m_inputRecording && m_inputRecording->IsActive() && !m_bApplyingRecordedInput;
+}
+
+void ABatteryCollectorCharacter::ApplyInputFrame(const FRecordedInputFrame& frame)
+{
+	m_bApplyingRecordedInput = true;
+
+	MoveForward(FRecordedInputFrame::DequantizeAxis(frame.moveForward));
+	MoveRight(FRecordedInputFrame::DequantizeAxis(frame.moveRight));
+	AddControllerYawInput(frame.turn);
+	AddControllerPitchInput(frame.lookUp);
+
+	if(frame.actions & eRecordedAction::eJumpPressed) {
+		Jump();
+	}
+	if(frame.actions & eRecordedAction::eJumpReleased) {
+		StopJumping();
+	}
+	if(frame.actions & eRecordedAction::eCollectPressed) {
+		CollectPickups();
+	}
+
+	m_bApplyingRecordedInput = false;
 }
 
 
 void ABatteryCollectorCharacter::CollectPickups() {
 
-	//Get all overlapping Actors and store them
-	TArray<AActor*> collectedActors;
-	CollectionSphere->GetOverlappingActors(collectedActors);
+	//Pickups and power belong to the server, clients predict and ask
+	if(Role < ROLE_Authority) {
+		PredictCollectPickups(MAX_int32);
+		return;
+	}
+
+	CollectCandidates(MAX_int32);
+
+}
+
+void ABatteryCollectorCharacter::AutoCollect(bool bEnable) {
+
+	bAutoCollect = bEnable;
+
+}
+
+void ABatteryCollectorCharacter::OnCollectionSphereBeginOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult) {
+
+	APickup* const pickup = Cast<APickup>(OtherActor);
+	if(pickup) {
+		m_collectCandidates.Add(pickup);
+	}
+
+}
+
+void ABatteryCollectorCharacter::OnCollectionSphereEndOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex) {
+
+	APickup* const pickup = Cast<APickup>(OtherActor);
+	if(pickup) {
+		m_collectCandidates.Remove(pickup);
+	}
+
+}
+
+void ABatteryCollectorCharacter::TakeCollectCandidates(int32 maxPickups, TArray<APickup*>& outPickups) {
+
+	//Inactive pickups stay in the set, they can come back on where they are without a new overlap and leaving reach
+	//takes them out. Anything taken, gone or waiting on the server leaves it
+	for(auto iterator = m_collectCandidates.CreateIterator(); iterator && outPickups.Num() < maxPickups; ++iterator) {
+		APickup* const pickup = iterator->Get();
+		if(pickup && !pickup->IsPendingKill() && !pickup->IsActive()) {
+			continue;
+		}
+
+		iterator.RemoveCurrent();
+		if(pickup && !pickup->IsPendingKill() && !pickup->IsPredictedCollected()) {
+			outPickups.Add(pickup);
+		}
+	}
+
+}
+
+void ABatteryCollectorCharacter::CollectCandidates(int32 maxPickups) {
+
+	BATTERY_SCOPE_CYCLE_COUNTER(CollectPickups);
+
+	//Taken out of the set first, collecting can destroy pickups and fire end overlap events
+	TArray<APickup*> collectedPickups;
+	TakeCollectCandidates(maxPickups, collectedPickups);
+	if(collectedPickups.Num() == 0) {
+		return;
+	}
 
 	//Keep track of collected power
 	float collectedPower = 0.0f;
 
-	//For each actor we collected
-	for(int32 iCollected = 0; iCollected < collectedActors.Num(); iCollected++) {
+	for(APickup* const pickup : collectedPickups) {
+		ABatteryPickup* const battery = Cast<ABatteryPickup>(pickup);
+		const float power = battery ? battery->GetPower() : 0.0f;
+		collectedPower += power;
+		FBatteryEventLog::LogCollect(pickup, this, power);
 
-		//Cast the actor to APickup
-		APickup* const testPickup = Cast<APickup>(collectedActors[iCollected]);
+		//The pickup may give up its registry slot or go back to its pool as it is collected
+		pickup->WasCollected();
+		pickup->SetActive(false);
+	}
 
-		//If the cast is successful and the pickup is valid and active
-		if(testPickup && !testPickup->IsPendingKill() && testPickup->IsActive()) {
+	ABatteryCollectorGameMode* const gameMode = GetWorld()->GetAuthGameMode<ABatteryCollectorGameMode>();
+	if(gameMode) {
+		gameMode->RecordPickupsCollected(collectedPickups.Num());
+	}
+	BATTERY_INC_COUNTER_BY(Collections, collectedPickups.Num());
 
-			//Call the pickup's WasCollected function
-			testPickup->WasCollected();
+	if(collectedPower > 0) {
+		UpdatePower(collectedPower, ePowerChangeReason::ePickup);
+	}
 
-			//Check to see if pickup is battery
-			ABatteryPickup* const testBattery = Cast<ABatteryPickup>(testPickup);
+}
 
-			if(testBattery) {
-				//Increase collected power
-				collectedPower += testBattery->GetPower();
-				UE_LOG(LogClass, Log, TEXT("battery"));
-			}
+void ABatteryCollectorCharacter::PredictCollectPickups(int32 maxPickups) {
+
+	BATTERY_SCOPE_CYCLE_COUNTER(CollectPickups);
+
+	TArray<APickup*> candidates;
+	TakeCollectCandidates(maxPickups, candidates);
+	if(candidates.Num() == 0) {
+		return;
+	}
 
-			//Deactivate the pickup
-			testPickup->SetActive(false);
+	FPendingCollect pending;
+	pending.sequence = m_nextCollectSequence++;
+	pending.predictedPower = 0.0f;
+	pending.sendTime = FPlatformTime::Seconds();
+
+	TArray<APickup*> batch;
+	for(APickup* const pickup : candidates) {
+		ABatteryPickup* const battery = Cast<ABatteryPickup>(pickup);
+		pending.predictedPower += battery ? battery->GetPower() : 0.0f;
+
+		pickup->SetPredictedCollected(true);
+		pending.pickups.Add(pickup);
+		batch.Add(pickup);
+	}
+
+	ServerCollectBatch(pending.sequence, batch);
+
+	m_predictionStats.batches++;
+	m_predictionStats.predicted += batch.Num();
+	m_pendingCollects.Add(pending);
+
+	//Show the predicted power straight away
+	RefreshPowerEffects(ePowerChangeReason::ePickup);
+	OnPowerChanged.Broadcast(this);
+
+}
+
+float ABatteryCollectorCharacter::GetPendingPredictedPower() const {
+
+	float pendingPower = 0.0f;
+	for(const FPendingCollect& pending : m_pendingCollects) {
+		pendingPower += pending.predictedPower;
+	}
+	return pendingPower;
+
+}
+
+bool ABatteryCollectorCharacter::ServerCollectBatch_Validate(uint16 sequence, const TArray<APickup*>& pickups) {
+	//One press can't reach more than a few dozen pickups, anything far beyond that isn't a real client
+	return pickups.Num() <= 1024;
+}
+
+void ABatteryCollectorCharacter::ServerCollectBatch_Implementation(uint16 sequence, const TArray<APickup*>& pickups) {
+
+	BATTERY_SCOPE_CYCLE_COUNTER(CollectPickups);
+
+	const FVector center = CollectionSphere->GetComponentLocation();
+	const float reach = CollectionSphere->GetScaledSphereRadius() + collectValidationSlack;
+
+	float collectedPower = 0.0f;
+	int32 collectedCount = 0;
+	TArray<uint16> rejectedIndices;
+
+	for(int32 iPickup = 0; iPickup < pickups.Num(); iPickup++) {
+		APickup* const pickup = pickups[iPickup];
+
+		//Gone, already collected by someone else, or too far from where the server has us
+		if(pickup == nullptr || pickup->IsPendingKill() || !pickup->IsActive() ||
+			FVector::DistSquared(pickup->GetActorLocation(), center) > FMath::Square(reach + pickup->GetMesh()->Bounds.SphereRadius)) {
+			rejectedIndices.Add((uint16)iPickup);
+			continue;
 		}
+
+		ABatteryPickup* const battery = Cast<ABatteryPickup>(pickup);
+		const float power = battery ? battery->GetPower() : 0.0f;
+		collectedPower += power;
+		FBatteryEventLog::LogCollect(pickup, this, power);
+
+		pickup->WasCollected();
+		pickup->SetActive(false);
+		collectedCount++;
+	}
+
+	ABatteryCollectorGameMode* const gameMode = GetWorld()->GetAuthGameMode<ABatteryCollectorGameMode>();
+	if(gameMode) {
+		gameMode->RecordPickupsCollected(collectedCount);
 	}
+	BATTERY_INC_COUNTER_BY(Collections, collectedCount);
 
+	//One power change for the whole batch
 	if(collectedPower > 0) {
-		UpdatePower(collectedPower);
+		UpdatePower(collectedPower, ePowerChangeReason::ePickup);
 	}
 
+	//The answer carries the power with it so the client never shows the batch undone before the property arrives
+	ClientConfirmCollect(sequence, rejectedIndices, m_replicatedPower);
+
+}
+
+void ABatteryCollectorCharacter::ClientConfirmCollect_Implementation(uint16 sequence, const TArray<uint16>& rejectedIndices, FReplicatedPower power) {
+
+	const int32 pendingIndex = m_pendingCollects.IndexOfByPredicate([sequence](const FPendingCollect& pending) {
+		return pending.sequence == sequence;
+	});
+	if(pendingIndex == INDEX_NONE) {
+		return;
+	}
+
+	const FPendingCollect& pending = m_pendingCollects[pendingIndex];
+
+	//Roll back what the server refused
+	for(const uint16 rejectedIndex : rejectedIndices) {
+		APickup* const pickup = pending.pickups.IsValidIndex(rejectedIndex) ? pending.pickups[rejectedIndex].Get() : nullptr;
+		if(pickup && pickup->IsPredictedCollected()) {
+			pickup->SetPredictedCollected(false);
+			//Collectable again if it is still in reach
+			if(CollectionSphere->IsOverlappingActor(pickup)) {
+				m_collectCandidates.Add(pickup);
+			}
+		}
+	}
+
+	const float latency = (float)(FPlatformTime::Seconds() - pending.sendTime);
+	m_predictionStats.confirmedBatches++;
+	m_predictionStats.confirmed += pending.pickups.Num() - rejectedIndices.Num();
+	m_predictionStats.totalLatency += latency;
+	m_predictionStats.maxLatency = FMath::Max(m_predictionStats.maxLatency, latency);
+
+	//The server's power replaces the prediction, which usually got it right
+	const float shownPower = GetCurrentPower();
+	m_pendingCollects.RemoveAt(pendingIndex);
+	m_replicatedPower = power;
+	ApplyServerPower(shownPower);
+
+}
+
+void ABatteryCollectorCharacter::CollectPredictionStats() {
+
+	const FCollectPredictionStats& stats = m_predictionStats;
+	UE_LOG(LogClass, Log, TEXT("CollectPredictionStats: %d batches (%d answered, %d pending), %d of %d predicted pickups confirmed (%.1f%%), collect-to-confirm avg %.1f ms max %.1f ms"),
+		stats.batches, stats.confirmedBatches, m_pendingCollects.Num(), stats.confirmed, stats.predicted,
+		stats.predicted > 0 ? 100.0f * stats.confirmed / stats.predicted : 100.0f,
+		stats.confirmedBatches > 0 ? stats.totalLatency * 1000.0 / stats.confirmedBatches : 0.0, stats.maxLatency * 1000.0f);
+
 }
 
 //Reports starting power
@@ -138,16 +502,164 @@ float ABatteryCollectorCharacter::GetInitialPower() {
 
 //Reports current power
 float ABatteryCollectorCharacter::GetCurrentPower() {
-	return characterPower;
+	//Clients only have what the server last sent
+	if(Role < ROLE_Authority) {
+		AGameStateBase* const gameState = GetWorld()->GetGameState();
+		return m_replicatedPower.GetPowerAt(gameState ? gameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds()) + GetPendingPredictedPower();
+	}
+
+	//Decay is linear so it can be worked out on demand
+	return BatteryPowerSim::PowerAt(characterPower, m_powerTimestamp, m_powerDecayRate, GetWorld()->GetTimeSeconds());
 }
 
 //Called whenever power is increased or decreased
-void ABatteryCollectorCharacter::UpdatePower(float powerChange) {
+void ABatteryCollectorCharacter::UpdatePower(float powerChange, ePowerChangeReason reason) {
+	BATTERY_SCOPE_CYCLE_COUNTER(UpdatePower);
+
 	//Change power
+	RebasePower();
 	characterPower += powerChange;
-	//Change speed based on power
-	GetCharacterMovement()->MaxWalkSpeed = baseSpeed + speedFactor * characterPower;
-	//Call visual effect
+	UpdateReplicatedPower();
+	FBatteryEventLog::LogPowerChange(this, (uint8)reason, characterPower, powerChange);
+	//Change speed and call visual effect
+	RefreshPowerEffects(reason);
+	OnPowerChanged.Broadcast(this);
+
+	//Let the game mode re-check the win and loss against the new power
+	ABatteryCollectorGameMode* const gameMode = GetWorld()->GetAuthGameMode<ABatteryCollectorGameMode>();
+	if(gameMode) {
+		gameMode->OnCharacterPowerChanged(this);
+	}
+}
+
+void ABatteryCollectorCharacter::SetPowerDecayRate(float decayPerSecond) {
+	RebasePower();
+	m_powerDecayRate = FMath::Max(decayPerSecond, 0.0f);
+	UpdateReplicatedPower();
+	UpdatePowerRefreshTimer(m_powerDecayRate);
+	OnPowerChanged.Broadcast(this);
+}
+
+void ABatteryCollectorCharacter::UpdatePowerRefreshTimer(float decayPerSecond) {
+	//Speed and effects only need refreshing while the power is moving
+	if(decayPerSecond > 0.0f) {
+		GetWorldTimerManager().SetTimer(m_powerRefreshTimer, this, &ABatteryCollectorCharacter::RefreshDecayEffects, powerRefreshInterval, true);
+	} else {
+		GetWorldTimerManager().ClearTimer(m_powerRefreshTimer);
+	}
+}
+
+void ABatteryCollectorCharacter::UpdateReplicatedPower() {
+	//Called right after a rebase, so characterPower is the power now
+	const bool bSameDecay = FMath::IsNearlyEqual(m_replicatedPower.decayPerSecond, m_powerDecayRate);
+	if(bSameDecay && FMath::Abs(m_replicatedPower.GetPowerAt(m_powerTimestamp) - characterPower) < powerReplicationThreshold) {
+		return;
+	}
+
+	m_replicatedPower.power = characterPower;
+	m_replicatedPower.timestamp = m_powerTimestamp;
+	m_replicatedPower.decayPerSecond = m_powerDecayRate;
+}
+
+void ABatteryCollectorCharacter::OnRep_ReplicatedPower() {
+	//A confirm may already have applied this power
+	AGameStateBase* const gameState = GetWorld()->GetGameState();
+	const float serverTime = gameState ? gameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds();
+	ApplyServerPower(m_appliedPower.GetPowerAt(serverTime) + GetPendingPredictedPower());
+}
+
+void ABatteryCollectorCharacter::ApplyServerPower(float shownPower) {
+	m_appliedPower = m_replicatedPower;
+	//Corrections from the server are small, bigger jumps are collects this client didn't predict
+	if(FMath::Abs(GetCurrentPower() - shownPower) >= powerReplicationThreshold) {
+		RefreshPowerEffects(ePowerChangeReason::eExternal);
+	}
+	UpdatePowerRefreshTimer(m_replicatedPower.decayPerSecond);
+	OnPowerChanged.Broadcast(this);
+}
+
+float ABatteryCollectorCharacter::GetTimeUntilPower(float powerLevel) {
+	//Clients drain at the replicated rate
+	return BatteryPowerSim::TimeUntilPower(GetCurrentPower(), GetPowerDecayRate(), powerLevel);
+}
+
+void ABatteryCollectorCharacter::RebasePower() {
+	characterPower = GetCurrentPower();
+	m_powerTimestamp = GetWorld()->GetTimeSeconds();
+}
+
+void ABatteryCollectorCharacter::RefreshPowerEffects(ePowerChangeReason reason) {
+	const float power = GetCurrentPower();
+
+	//Change speed based on power, when the difference would show
+	UCharacterMovementComponent* const movement = GetCharacterMovement();
+	const float walkSpeed = BatteryPowerSim::WalkSpeed(baseSpeed, speedFactor, power);
+	if(FMath::Abs(walkSpeed - movement->MaxWalkSpeed) >= walkSpeedEpsilon) {
+		movement->MaxWalkSpeed = walkSpeed;
+	}
+
+	//Nobody sees the effect on a dedicated server
+	if(GetNetMode() == NM_DedicatedServer) {
+		return;
+	}
+
+	//Gather the change, the effect fires once for everything in the window
+	m_pendingEffectDelta += power - m_effectPower;
+	m_effectPower = power;
+	m_pendingEffectReason = m_bEffectPending ? FMath::Max(m_pendingEffectReason, reason) : reason;
+	m_bEffectPending = true;
+
+	if(effectCoalesceWindow <= 0.0f) {
+		FlushPowerEffect();
+	} else if(!GetWorldTimerManager().IsTimerActive(m_effectCoalesceTimer)) {
+		GetWorldTimerManager().SetTimer(m_effectCoalesceTimer, this, &ABatteryCollectorCharacter::FlushPowerEffect, effectCoalesceWindow, false);
+	}
+}
+
+void ABatteryCollectorCharacter::RefreshDecayEffects() {
+	RefreshPowerEffects(ePowerChangeReason::eDecay);
+}
+
+void ABatteryCollectorCharacter::FlushPowerEffect() {
+	if(!m_bEffectPending) {
+		return;
+	}
+
+	float threshold = externalEffectThreshold;
+	if(m_pendingEffectReason == ePowerChangeReason::eDecay) {
+		threshold = decayEffectThreshold;
+	} else if(m_pendingEffectReason == ePowerChangeReason::ePickup) {
+		threshold = pickupEffectThreshold;
+	}
+
+	//Filtered out entirely
+	if(threshold < 0.0f) {
+		m_pendingEffectDelta = 0.0f;
+		m_bEffectPending = false;
+		return;
+	}
+
+	//Anything but decay that came to nothing is dropped, it would get past the default threshold of 0
+	if(m_pendingEffectReason != ePowerChangeReason::eDecay && FMath::IsNearlyZero(m_pendingEffectDelta, KINDA_SMALL_NUMBER)) {
+		m_bEffectPending = false;
+		return;
+	}
+
+	//Too small to show yet - keep it, small decays add up until they cross the threshold
+	if(FMath::Abs(m_pendingEffectDelta) < threshold) {
+		return;
+	}
+
+	const float powerDelta = m_pendingEffectDelta;
+	const ePowerChangeReason reason = m_pendingEffectReason;
+	m_pendingEffectDelta = 0.0f;
+	m_bEffectPending = false;
+
+	PowerEffect(powerDelta, reason);
+}
+
+void ABatteryCollectorCharacter::PowerEffect_Implementation(float powerDelta, ePowerChangeReason reason) {
+	//Existing Blueprints only implement the plain event
 	PowerChangeEffect();
 }
 
@@ -158,28 +670,79 @@ void ABatteryCollectorCharacter::OnResetVR()
 
 void ABatteryCollectorCharacter::TouchStarted(ETouchIndex::Type FingerIndex, FVector Location)
 {
-		Jump();
+		OnJumpPressed();
 }
 
 void ABatteryCollectorCharacter::TouchStopped(ETouchIndex::Type FingerIndex, FVector Location)
 {
-		StopJumping();
+		OnJumpReleased();
+}
+
+void ABatteryCollectorCharacter::OnJumpPressed()
+{
+	if(IsInputRouted()) {
+		m_pendingActions |= eRecordedAction::eJumpPressed;
+		return;
+	}
+	Jump();
+}
+
+void ABatteryCollectorCharacter::OnJumpReleased()
+{
+	if(IsInputRouted()) {
+		m_pendingActions |= eRecordedAction::eJumpReleased;
+		return;
+	}
+	StopJumping();
+}
+
+void ABatteryCollectorCharacter::OnCollectPressed()
+{
+	if(IsInputRouted()) {
+		m_pendingActions |= eRecordedAction::eCollectPressed;
+		return;
+	}
+	CollectPickups();
+}
+
+void ABatteryCollectorCharacter::Turn(float Value)
+{
+	if(IsInputRouted()) {
+		m_pendingTurn += Value;
+		return;
+	}
+	AddControllerYawInput(Value);
+}
+
+void ABatteryCollectorCharacter::LookUp(float Value)
+{
+	if(IsInputRouted()) {
+		m_pendingLookUp += Value;
+		return;
+	}
+	AddControllerPitchInput(Value);
 }
 
 void ABatteryCollectorCharacter::TurnAtRate(float Rate)
 {
 	// calculate delta for this frame from the rate information
-	AddControllerYawInput(Rate * BaseTurnRate * GetWorld()->GetDeltaSeconds());
+	Turn(Rate * BaseTurnRate * GetWorld()->GetDeltaSeconds());
 }
 
 void ABatteryCollectorCharacter::LookUpAtRate(float Rate)
 {
 	// calculate delta for this frame from the rate information
-	AddControllerPitchInput(Rate * BaseLookUpRate * GetWorld()->GetDeltaSeconds());
+	LookUp(Rate * BaseLookUpRate * GetWorld()->GetDeltaSeconds());
 }
 
 void ABatteryCollectorCharacter::MoveForward(float Value)
 {
+	//Recorded input is applied once per frame from Tick
+	if(IsInputRouted()) {
+		m_pendingMoveForward = Value;
+		return;
+	}
+
 	if ((Controller != NULL) && (Value != 0.0f))
 	{
 		// find out which way is forward
@@ -194,6 +757,11 @@ void ABatteryCollectorCharacter::MoveForward(float Value)
 
 void ABatteryCollectorCharacter::MoveRight(float Value)
 {
+	if(IsInputRouted()) {
+		m_pendingMoveRight = Value;
+		return;
+	}
+
 	if ( (Controller != NULL) && (Value != 0.0f) )
 	{
 		// find out which way is right
@@ -1,8 +1,68 @@
 // Copyright 1998-2017 Epic Games, Inc. All Rights Reserved.
 #pragma once
 #include "GameFramework/Character.h"
+#include "InputRecording.h"
+#include "BatteryPowerSim.h"
 #include "BatteryCollectorCharacter.generated.h"
 
+//Power as clients see it - the level at a server time and how fast it decays from there
+USTRUCT()
+struct FReplicatedPower {
+	GENERATED_BODY()
+
+	UPROPERTY()
+	float power;
+
+	UPROPERTY()
+	float timestamp;
+
+	UPROPERTY()
+	float decayPerSecond;
+
+	FReplicatedPower() : power(0.0f), timestamp(0.0f), decayPerSecond(0.0f) {}
+
+	//Power at the given server time
+	FORCEINLINE float GetPowerAt(float serverTime) const { return BatteryPowerSim::PowerAt(power, timestamp, decayPerSecond, serverTime); }
+
+	//Power to a tenth and decay to a hundredth, packed
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+};
+
+//Why a character's power changed, ordered by priority - coalesced changes report the highest
+UENUM(BlueprintType)
+enum class ePowerChangeReason : uint8 {
+	//Steady drain while the match is running
+	eDecay,
+	//Anything else, e.g. a Blueprint calling UpdatePower
+	eExternal,
+	//Collected batteries
+	ePickup
+};
+
+//How well this client's collect predictions hold up against the server
+struct FCollectPredictionStats {
+	//Batches sent and answered
+	int32 batches;
+	int32 confirmedBatches;
+	//Pickups predicted and how many of those the server agreed with
+	int32 predicted;
+	int32 confirmed;
+	//Seconds from the key press to the server's answer
+	double totalLatency;
+	float maxLatency;
+
+	FCollectPredictionStats() : batches(0), confirmedBatches(0), predicted(0), confirmed(0), totalLatency(0.0), maxLatency(0.0f) {}
+};
+
+template<>
+struct TStructOpsTypeTraits<FReplicatedPower> : public TStructOpsTypeTraitsBase {
+	enum {
+		WithNetSerializer = true
+	};
+};
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FCharacterPowerEvent, class ABatteryCollectorCharacter*);
+
 UCLASS(config=Game)
 class ABatteryCollectorCharacter : public ACharacter
 {
@@ -23,6 +83,14 @@ class ABatteryCollectorCharacter : public ACharacter
 public:
 	ABatteryCollectorCharacter();
 
+	virtual void BeginPlay() override;
+
+	virtual void Tick(float DeltaSeconds) override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
 	/** Base turn rate, in deg/sec. Other scaling may affect final turn rate. */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category=Camera)
 	float BaseTurnRate;
@@ -54,6 +122,21 @@ protected:
 	 */
 	void LookUpAtRate(float Rate);
 
+	/** Called for mouse yaw input */
+	void Turn(float Value);
+
+	/** Called for mouse pitch input */
+	void LookUp(float Value);
+
+	//Console command - logs the collect prediction hit rate and collect-to-confirm latency on this client
+	UFUNCTION(Exec)
+	void CollectPredictionStats();
+
+	/** Action handlers, routed through the input recording when one is running */
+	void OnJumpPressed();
+	void OnJumpReleased();
+	void OnCollectPressed();
+
 	/** Handler for when a touch input begins. */
 	void TouchStarted(ETouchIndex::Type FingerIndex, FVector Location);
 
@@ -65,10 +148,6 @@ protected:
 	virtual void SetupPlayerInputComponent(class UInputComponent* PlayerInputComponent) override;
 	// End of APawn interface
 
-	//Called when we press a key to collect any pickups inside the CollectionSphere
-	UFUNCTION(BlueprintCallable, Category = "Pickups")
-	void CollectPickups();
-
 	//Starting power level of character
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Power", meta = (BlueprintProtected = "true"))
 	float initialPower;
@@ -81,15 +160,183 @@ protected:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Power", meta = (BlueprintProtected = "true"))
 	float baseSpeed;
 
+	//Seconds between speed and effect refreshes while power is decaying
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Power", meta = (BlueprintProtected = "true", ClampMin = "0.01"))
+	float powerRefreshInterval;
+
+	//Collect pickups as they come into reach instead of on the Collect action
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Pickups", meta = (BlueprintProtected = "true"))
+	bool bAutoCollect;
+
+	//Most pickups auto collect takes in a frame, the rest wait for the next one
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Pickups", meta = (BlueprintProtected = "true", ClampMin = "1"))
+	int32 autoCollectBudgetPerFrame;
+
+	//Console command - turn auto collect on or off for this player
+	UFUNCTION(Exec)
+	void AutoCollect(bool bEnable);
+
+	//Extra reach the server allows when checking a client's collect, to cover movement during the round trip
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Pickups", meta = (BlueprintProtected = "true", ClampMin = "0.0"))
+	float collectValidationSlack;
+
+	//Clients are only sent a new power level when it is at least this far from what they would work out themselves
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Power", meta = (BlueprintProtected = "true", ClampMin = "0.0"))
+	float powerReplicationThreshold;
+
+	//Seconds power changes are gathered for before the effect fires once for all of them, 0 fires on every change
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Power|Effects", meta = (BlueprintProtected = "true", ClampMin = "0.0"))
+	float effectCoalesceWindow;
+
+	//Least decay the effect fires for, negative to never fire for decay
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Power|Effects", meta = (BlueprintProtected = "true"))
+	float decayEffectThreshold;
+
+	//Least collected power the effect fires for, negative to never fire for pickups
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Power|Effects", meta = (BlueprintProtected = "true"))
+	float pickupEffectThreshold;
+
+	//Least power change from other sources the effect fires for, negative to never fire for them
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Power|Effects", meta = (BlueprintProtected = "true"))
+	float externalEffectThreshold;
+
+	//Walk speed changes smaller than this are not applied
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Power", meta = (BlueprintProtected = "true", ClampMin = "0.0"))
+	float walkSpeedEpsilon;
+
 	UFUNCTION(BlueprintImplementableEvent, Category = "Power")
 	void PowerChangeEffect();
 
+	/**
+	 * Fired once per coalescing window for the power changes that pass their threshold - calls PowerChangeEffect by default
+	 * @param powerDelta	Power gained or lost since the effect last fired
+	 * @param reason	Highest priority reason among the changes
+	 */
+	UFUNCTION(BlueprintNativeEvent, Category = "Power")
+	void PowerEffect(float powerDelta, ePowerChangeReason reason);
+	virtual void PowerEffect_Implementation(float powerDelta, ePowerChangeReason reason);
+
 private:
-	//Current power level of our character
+	//Power level of our character at m_powerTimestamp, the current power decays linearly from it
 	UPROPERTY(VisibleAnywhere, Category = "Power")
 	float characterPower;
 
+	//Game time characterPower was last rebased at
+	float m_powerTimestamp;
+
+	//Power lost per second
+	float m_powerDecayRate;
+
+	//Keeps speed and effects in step with the decaying power
+	FTimerHandle m_powerRefreshTimer;
+
+	//Clients work out the current power from this, it only changes when the power jumps or the decay rate changes
+	UPROPERTY(ReplicatedUsing = OnRep_ReplicatedPower)
+	FReplicatedPower m_replicatedPower;
+
+	UFUNCTION()
+	void OnRep_ReplicatedPower();
+
+	//Server power the client last applied, replicated or sent with a collect confirm
+	FReplicatedPower m_appliedPower;
+
+	//Take on m_replicatedPower. The effects only refresh when it moves the power away from shownPower, what the
+	//client showed before it
+	void ApplyServerPower(float shownPower);
+
+	//Send the power to clients if theirs has drifted past the threshold - server only
+	void UpdateReplicatedPower();
+
+	//Start or stop the effect refresh timer to match the decay rate
+	void UpdatePowerRefreshTimer(float decayPerSecond);
+
+	//A collect this client has predicted and is waiting on the server for
+	struct FPendingCollect {
+		uint16 sequence;
+		TArray<TWeakObjectPtr<class APickup>> pickups;
+		float predictedPower;
+		double sendTime;
+	};
+
+	TArray<FPendingCollect> m_pendingCollects;
+	uint16 m_nextCollectSequence;
+	FCollectPredictionStats m_predictionStats;
+
+	//Pickups in reach that haven't been collected, kept by the collection sphere's overlap events
+	TSet<TWeakObjectPtr<class APickup>> m_collectCandidates;
+
+	UFUNCTION()
+	void OnCollectionSphereBeginOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult);
+
+	UFUNCTION()
+	void OnCollectionSphereEndOverlap(UPrimitiveComponent* OverlappedComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex);
+
+	//Take up to maxPickups collectable candidates out of the set, gone ones are dropped on the way and inactive ones kept
+	void TakeCollectCandidates(int32 maxPickups, TArray<class APickup*>& outPickups);
+
+	//Server side collect of up to maxPickups candidates
+	void CollectCandidates(int32 maxPickups);
+
+	//Client side collect - hide up to maxPickups candidates and send them to the server in one batch
+	void PredictCollectPickups(int32 maxPickups);
+
+	//Power this client has predicted but not had confirmed yet
+	float GetPendingPredictedPower() const;
+
+	//Collect the listed pickups that the server agrees are active and in reach, then answer with the ones it refused
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerCollectBatch(uint16 sequence, const TArray<class APickup*>& pickups);
+
+	//The server's answer to a batch - refused pickups are shown again and the power is corrected
+	UFUNCTION(Client, Reliable)
+	void ClientConfirmCollect(uint16 sequence, const TArray<uint16>& rejectedIndices, FReplicatedPower power);
+
+	//Fold the decay so far into characterPower and move the timestamp to now
+	void RebasePower();
+
+	//Apply the current power to walk speed and queue the visual effect
+	void RefreshPowerEffects(ePowerChangeReason reason);
+
+	//Refresh timer callback while power is decaying
+	void RefreshDecayEffects();
+
+	//Fire the effect for the changes gathered so far if they pass their threshold
+	void FlushPowerEffect();
+
+	//Power the last queued change was measured to
+	float m_effectPower;
+
+	//Change gathered since the effect last fired
+	float m_pendingEffectDelta;
+	ePowerChangeReason m_pendingEffectReason;
+	bool m_bEffectPending;
+
+	FTimerHandle m_effectCoalesceTimer;
+
+	//The game mode's recording or replay while the first player controls us, otherwise null
+	FInputRecording* m_inputRecording;
+
+	//Input gathered from the bindings this frame, applied from Tick while recording
+	float m_pendingMoveForward;
+	float m_pendingMoveRight;
+	float m_pendingTurn;
+	float m_pendingLookUp;
+	uint8 m_pendingActions;
+
+	//True while Tick is applying a recorded frame through the regular handlers
+	bool m_bApplyingRecordedInput;
+
+	//True when live input should be captured (recording) or ignored (replaying) instead of applied
+	bool IsInputRouted() const;
+
+	//Drive the character from one frame of recorded input
+	void ApplyInputFrame(const FRecordedInputFrame& frame);
+
 public:
+	//Called when we press a key to collect any pickups inside the CollectionSphere - bots call it directly
+	UFUNCTION(BlueprintCallable, Category = "Pickups")
+	void CollectPickups();
+
 	/** Returns CameraBoom subobject **/
 	FORCEINLINE class USpringArmComponent* GetCameraBoom() const { return CameraBoom; }
 	/** Returns FollowCamera subobject **/
@@ -107,9 +354,26 @@ public:
 	/**
 	Function to update the character's power
 	* @param PowerChange This is the amount to change the power by, can be positive or negative
+	* @param reason Where the change came from, picks which effect threshold applies
+	*/
+	UFUNCTION(BlueprintCallable, Category = "Power")
+	void UpdatePower(float powerChange, ePowerChangeReason reason = ePowerChangeReason::eExternal);
+
+	/**
+	Set how fast the character's power drains
+	* @param decayPerSecond Power lost every second, 0 stops the decay
 	*/
 	UFUNCTION(BlueprintCallable, Category = "Power")
-	void UpdatePower(float powerChange);
+	void SetPowerDecayRate(float decayPerSecond);
+
+	//Seconds until the decaying power falls to the given level, negative if it never will
+	float GetTimeUntilPower(float powerLevel);
+
+	//Power lost per second - clients have what the server last sent
+	FORCEINLINE float GetPowerDecayRate() const { return Role < ROLE_Authority ? m_replicatedPower.decayPerSecond : m_powerDecayRate; }
+
+	//Power jumped or started or stopped decaying, on the server and on clients. Steady decay is not broadcast
+	FCharacterPowerEvent OnPowerChanged;
 
 };
 
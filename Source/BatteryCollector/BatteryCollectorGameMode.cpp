@@ -6,46 +6,144 @@
 #include "Kismet/GameplayStatics.h"
 #include "Blueprint/UserWidget.h"
 #include "SpawnVolume.h"
+#include "Pickup.h"
+#include "BatteryPickup.h"
+#include "BatteryInstanceField.h"
+#include "BatteryBenchmark.h"
+#include "PickupTypeAsset.h"
+#include "BatteryEventLog.h"
 
 ABatteryCollectorGameMode::ABatteryCollectorGameMode()
 {
-	// set default pawn class to our Blueprinted character
-	static ConstructorHelpers::FClassFinder<APawn> PlayerPawnBPClass(TEXT("/Game/ThirdPersonCPP/Blueprints/ThirdPersonCharacter"));
-	if (PlayerPawnBPClass.Class != NULL)
-	{
-		DefaultPawnClass = PlayerPawnBPClass.Class;
-		PrimaryActorTick.bCanEverTick = true;
-	}
+	//Our Blueprinted character, streamed in once play begins rather than loaded with this class
+	playerPawnClass = TAssetSubclassOf<APawn>(FStringAssetReference(TEXT("/Game/ThirdPersonCPP/Blueprints/ThirdPersonCharacter.ThirdPersonCharacter_C")));
+
+	//Played the first time a battery is collected
+	preloadAssets.Add(FStringAssetReference(TEXT("/Game/ExampleContent/Effects/ParticleSystems/P_electricity_arc.P_electricity_arc")));
+	m_bPreloading = true;
+	m_initGameTime = 0.0;
+	m_beginPlayTime = 0.0;
+	m_preloadDoneTime = 0.0;
+	m_firstFrameTime = 0.0;
+	m_preloadAssetCount = 0;
+
+	//Power decay is worked out on demand and the win and loss are event driven, the tick only runs due spawns
+	//and is switched on for as long as the match is played
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
 
 	//Base decay rate
 	decayRate = 0.01f;
 
+	//Pickup index cell size
+	pickupIndexCellSize = 400.0f;
+
+	//Instancing of distant batteries is opt in
+	bInstanceDistantBatteries = false;
+	batteryPromoteRange = 1500.0f;
+	batteryDemoteRange = 2500.0f;
+	batteryInstancingInterval = 0.25f;
+	m_instanceField = nullptr;
+
+	//Spawn scheduling
+	spawnBudgetPerFrame = 4;
+	maxLivePickups = 500;
+	spawnSchedulerResolution = 0.1f;
+
+	//Spawn volume significance
+	bUseSpawnSignificance = true;
+	fullSignificanceRange = 4000.0f;
+	pausedSignificanceRange = 10000.0f;
+	inViewRangeScale = 1.5f;
+	inViewHalfAngle = 60.0f;
+	significanceInterval = 0.5f;
+
+	//Bots
+	botDecisionInterval = 0.25f;
+	botSearchRadius = 3000.0f;
+	bParallelBotDecisions = true;
+
+	//Checkpoints
+	checkpointRestoreBudgetMs = 2.0f;
+	checkpointAutosaveInterval = 0.0f;
+	m_restoreCursor = 0;
+	m_restoreFrames = 0;
+	m_restoreStart = 0.0;
+	m_restoreMaxFrameMs = 0.0f;
+
+	m_nextDepletionTime = MAX_flt;
+
+	m_pickupsSpawned = 0;
+	m_pickupsCollected = 0;
+
+}
+
+void ABatteryCollectorGameMode::InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage) {
+
+	m_initGameTime = FPlatformTime::Seconds() - GStartTime;
+
+	Super::InitGame(MapName, Options, ErrorMessage);
+
+	//Record or replay the first player's input if the command line asks for it
+	m_inputRecording.InitFromCommandLine();
+
+}
+
+void ABatteryCollectorGameMode::PostInitializeComponents() {
+
+	Super::PostInitializeComponents();
+
+	//Pickups register in their BeginPlay, so the registry has to be ready before then
+	m_pickupRegistry.SetCellSize(pickupIndexCellSize);
+
+	//64 slots covers a full turn of a few seconds, longer delays just wait a turn or more
+	m_spawnScheduler.Initialize(spawnSchedulerResolution, 64);
+
+	//Bots register as they are possessed, which can be before BeginPlay
+	m_botDecisions.Initialize(botDecisionInterval, botSearchRadius, bParallelBotDecisions);
+
 }
 
 void ABatteryCollectorGameMode::BeginPlay() {
 
 	Super::BeginPlay();
 
-	//Find all spawn volume actors
-	TArray<AActor*> foundActors;
-	UGameplayStatics::GetAllActorsOfClass(GetWorld(), ASpawnVolume::StaticClass(), foundActors);
+	m_beginPlayTime = FPlatformTime::Seconds() - GStartTime;
 
-	for(auto actor : foundActors) {
-		ASpawnVolume* spawnVolumeActor = Cast<ASpawnVolume>(actor);
-		if(spawnVolumeActor) {
-			m_spawnVolumeActors.AddUnique(spawnVolumeActor);
-		}
+	//Spawn volumes have registered themselves by now, or will as they begin play. The match starts once the preload is done
+	BeginPreload();
+
+	//The instances are only drawn here, clients of a server would see demoted batteries vanish
+	if(bInstanceDistantBatteries && GetNetMode() == NM_Standalone) {
+		m_instanceField = GetWorld()->SpawnActor<ABatteryInstanceField>();
+		GetWorldTimerManager().SetTimer(m_instancingTimer, this, &ABatteryCollectorGameMode::UpdateBatteryInstancing, batteryInstancingInterval, true);
 	}
 
-	SetCurrentState(eBatteryPlayState::ePlaying);
+	m_physicsStepTimer.Register(GetWorld());
 
-	//Set score to beat
-	ABatteryCollectorCharacter* myCharacter = Cast<ABatteryCollectorCharacter>(UGameplayStatics::GetPlayerPawn(this, 0));
-	if(myCharacter) {
-		powerToWin = myCharacter->GetInitialPower() * 1.25f;
+	//Stats CSV for headless runs
+	float statsCsvRate = 0.0f;
+	if(FParse::Value(FCommandLine::Get(), TEXT("BatteryStatsCsv="), statsCsvRate)) {
+		StartStatsCsv(statsCsvRate);
 	}
 
-	if(HUDWidgetClass != NULL) {
+	//Per-client bandwidth for dedicated server runs
+	float netReportInterval = 0.0f;
+	if(FParse::Value(FCommandLine::Get(), TEXT("NetBandwidthReport="), netReportInterval)) {
+		StartNetReport(netReportInterval);
+	}
+
+	//Binary gameplay event log, decoded offline with the BatteryEventDecode commandlet
+	if(FParse::Param(FCommandLine::Get(), TEXT("BatteryEventLog"))) {
+		StartEventLog();
+	}
+
+	if(checkpointAutosaveInterval > 0.0f) {
+		GetWorldTimerManager().SetTimer(m_autosaveTimer, this, &ABatteryCollectorGameMode::Autosave, checkpointAutosaveInterval, true);
+	}
+
+	//A dedicated server has no viewport to put a HUD in
+	if(HUDWidgetClass != NULL && GetNetMode() != NM_DedicatedServer) {
 		CurrentWidget = CreateWidget<UUserWidget>(GetWorld(), HUDWidgetClass);
 		if(CurrentWidget != nullptr)
 			CurrentWidget->AddToViewport();
@@ -53,26 +151,427 @@ void ABatteryCollectorGameMode::BeginPlay() {
 
 }
 
-void ABatteryCollectorGameMode::Tick(float DeltaTime) {
-	Super::Tick(DeltaTime);
-	
-	//Check we're using batter collector character
-	ABatteryCollectorCharacter* myCharacter = Cast<ABatteryCollectorCharacter>(UGameplayStatics::GetPlayerPawn(this, 0));
-	if(myCharacter) {
-		
-		//If our power exceeds level needed to win then switch game state
-		if(myCharacter->GetCurrentPower() > powerToWin) {
-			SetCurrentState(eBatteryPlayState::eWon);
+void ABatteryCollectorGameMode::BeginPreload() {
+
+	TArray<FStringAssetReference> assets;
+	if(playerPawnClass.IsPending()) {
+		assets.AddUnique(playerPawnClass.ToStringReference());
+	}
+	for(const FStringAssetReference& asset : preloadAssets) {
+		if(asset.IsValid() && asset.ResolveObject() == nullptr) {
+			assets.AddUnique(asset);
+		}
+	}
+	m_preloadAssetCount = assets.Num();
+
+	if(assets.Num() == 0) {
+		OnPreloadComplete();
+		return;
+	}
+
+	UPickupTypeAsset::GetStreamableManager().RequestAsyncLoad(assets, FStreamableDelegate::CreateUObject(this, &ABatteryCollectorGameMode::OnPreloadComplete));
+
+}
+
+void ABatteryCollectorGameMode::OnPreloadComplete() {
+
+	//Players spawn with it from here on
+	if(!playerPawnClass.IsNull()) {
+		if(playerPawnClass.Get() != NULL) {
+			DefaultPawnClass = playerPawnClass.Get();
+		} else {
+			UE_LOG(LogClass, Warning, TEXT("Can't load the player pawn %s, players get %s"), *playerPawnClass.ToStringReference().ToString(), *GetNameSafe(DefaultPawnClass));
+		}
+	}
+
+	//Wait a frame at least, so volumes beginning play after the game mode are in before the match starts
+	GetWorldTimerManager().SetTimerForNextTick(this, &ABatteryCollectorGameMode::FinishPreload);
+
+}
+
+void ABatteryCollectorGameMode::FinishPreload() {
+
+	//Types still streaming would have their first spawns skipped
+	for(ASpawnVolume* const volume : m_spawnVolumeActors) {
+		if(volume->IsLoadingPickupTypes()) {
+			GetWorldTimerManager().SetTimerForNextTick(this, &ABatteryCollectorGameMode::FinishPreload);
+			return;
+		}
+	}
+
+	m_bPreloading = false;
+	m_preloadDoneTime = FPlatformTime::Seconds() - GStartTime;
+
+	//Set score to beat - on a server players join after this, so it comes from the default pawn
+	ABatteryCollectorCharacter* const defaultCharacter = DefaultPawnClass != NULL ? Cast<ABatteryCollectorCharacter>(DefaultPawnClass->GetDefaultObject()) : nullptr;
+	if(defaultCharacter) {
+		powerToWin = BatteryPowerSim::PowerToWin(defaultCharacter->GetInitialPower());
+	}
+
+	SetCurrentState(eBatteryPlayState::ePlaying);
+
+	//Players who logged in during the preload get their pawns now, their power starts in SetPlayerDefaults
+	for(FConstPlayerControllerIterator iterator = GetWorld()->GetPlayerControllerIterator(); iterator; ++iterator) {
+		APlayerController* const controller = iterator->Get();
+		if(controller == nullptr) {
+			continue;
+		}
+		ABatteryCollectorCharacter* const character = Cast<ABatteryCollectorCharacter>(controller->GetPawn());
+		if(character) {
+			StartPlayerPower(character);
+		} else if(controller->GetPawn() == nullptr && PlayerCanRestart(controller)) {
+			RestartPlayer(controller);
+		}
+	}
+
+	//Headless load test - see ABatteryBenchmarkDirector for the command line
+	if(ABatteryBenchmarkDirector::IsBenchmarkRun()) {
+		GetWorld()->SpawnActor<ABatteryBenchmarkDirector>();
+	}
+
+	//Start from a saved match, e.g. a busy level for a benchmark
+	FString checkpointName;
+	if(FParse::Value(FCommandLine::Get(), TEXT("BatteryCheckpoint="), checkpointName)) {
+		LoadCheckpoint(checkpointName);
+	}
+
+}
+
+bool ABatteryCollectorGameMode::PlayerCanRestart_Implementation(APlayerController* Player) {
+
+	return !m_bPreloading && Super::PlayerCanRestart_Implementation(Player);
+
+}
+
+void ABatteryCollectorGameMode::RegisterSpawnVolume(ASpawnVolume* volume) {
+
+	if(m_spawnVolumeActors.Contains(volume)) {
+		return;
+	}
+	m_spawnVolumeActors.Add(volume);
+
+	//Streamed in or spawned during the match
+	if(m_currentState == eBatteryPlayState::ePlaying) {
+		volume->SetSpawningActive(true);
+	}
+
+}
+
+void ABatteryCollectorGameMode::UnregisterSpawnVolume(ASpawnVolume* volume) {
+
+	const int32 index = m_spawnVolumeActors.IndexOfByKey(volume);
+	if(index == INDEX_NONE) {
+		return;
+	}
+	m_spawnVolumeActors.RemoveAt(index);
+
+	//A restore in progress refers to volumes by index
+	for(int32& restoreIndex : m_restoreVolumes) {
+		if(restoreIndex == index) {
+			restoreIndex = INDEX_NONE;
+		} else if(restoreIndex > index) {
+			restoreIndex--;
+		}
+	}
+
+}
+
+void ABatteryCollectorGameMode::BenchmarkBotDecisions(int32 iterations) {
+
+	FPickupSnapshot& snapshot = m_botDecisions.GetSnapshot();
+	snapshot.Build(m_pickupRegistry, botSearchRadius);
+	if(snapshot.Num() == 0 || iterations <= 0) {
+		UE_LOG(LogClass, Warning, TEXT("BenchmarkBotDecisions: no active pickups to decide over"));
+		return;
+	}
+
+	//Bots scattered over the area the pickups cover, the same places every run
+	const FBox bounds = snapshot.GetBounds().ExpandBy(botSearchRadius * 0.5f);
+	FRandomStream random(1);
+
+	//The game thread works through the loop alongside the workers
+	const int32 threadCount = FTaskGraphInterface::Get().GetNumWorkerThreads() + 1;
+	UE_LOG(LogClass, Log, TEXT("BenchmarkBotDecisions: %d pickups, %d threads, %d iterations"), snapshot.Num(), threadCount, iterations);
+
+	const int32 botCounts[] = { 1, 10, 50, 100, 250, 500 };
+	TArray<FVector> locations;
+	TArray<int32> targets;
+
+	for(const int32 botCount : botCounts) {
+
+		locations.Reset();
+		for(int32 iBot = 0; iBot < botCount; iBot++) {
+			locations.Add(FVector(random.FRandRange(bounds.Min.X, bounds.Max.X), random.FRandRange(bounds.Min.Y, bounds.Max.Y), bounds.GetCenter().Z));
+		}
+
+		double busySeconds = 0.0;
+		double parallelBusySeconds = 0.0;
+
+		const double serialStart = FPlatformTime::Seconds();
+		for(int32 iRun = 0; iRun < iterations; iRun++) {
+			m_botDecisions.DecideTargets(snapshot, locations, targets, false, busySeconds);
+		}
+		const double serialTime = FPlatformTime::Seconds() - serialStart;
+
+		const double parallelStart = FPlatformTime::Seconds();
+		for(int32 iRun = 0; iRun < iterations; iRun++) {
+			m_botDecisions.DecideTargets(snapshot, locations, targets, true, busySeconds);
+			parallelBusySeconds += busySeconds;
+		}
+		const double parallelTime = FPlatformTime::Seconds() - parallelStart;
+
+		//Cores busy is the deciding time summed over threads for each second of wall time
+		const double coresBusy = parallelBusySeconds / FMath::Max(parallelTime, 1e-9);
+		UE_LOG(LogClass, Log, TEXT("BenchmarkBotDecisions %3d bots: serial %8.3f ms, parallel %8.3f ms, speedup %5.2fx, %5.2f cores busy (%5.1f%% of %d)"),
+			botCount, serialTime * 1000.0 / iterations, parallelTime * 1000.0 / iterations, serialTime / FMath::Max(parallelTime, 1e-9),
+			coresBusy, 100.0 * coresBusy / threadCount, threadCount);
+
+	}
+
+}
+
+void ABatteryCollectorGameMode::StartupTimings() {
+
+	if(m_firstFrameTime <= 0.0) {
+		UE_LOG(LogClass, Log, TEXT("Startup: still preloading (%d assets)"), m_preloadAssetCount);
+		return;
+	}
+
+	UE_LOG(LogClass, Log, TEXT("Startup: %.3f s from launch to the first playable frame"), m_firstFrameTime);
+	UE_LOG(LogClass, Log, TEXT("  engine init and map load  %8.3f s"), m_initGameTime);
+	UE_LOG(LogClass, Log, TEXT("  actor init                %8.3f s"), m_beginPlayTime - m_initGameTime);
+	UE_LOG(LogClass, Log, TEXT("  preload (%3d assets)      %8.3f s"), m_preloadAssetCount, m_preloadDoneTime - m_beginPlayTime);
+	UE_LOG(LogClass, Log, TEXT("  first frame               %8.3f s"), m_firstFrameTime - m_preloadDoneTime);
+
+}
+
+FInputRecording* ABatteryCollectorGameMode::GetInputRecording() {
+	return m_inputRecording.IsActive() ? &m_inputRecording : nullptr;
+}
+
+void ABatteryCollectorGameMode::EndPlay(const EEndPlayReason::Type EndPlayReason) {
+
+	StopStatsCsv();
+	StopNetReport();
+	StopEventLog();
+	m_inputRecording.Close();
+	m_physicsStepTimer.Unregister();
+
+	Super::EndPlay(EndPlayReason);
+
+}
+
+void ABatteryCollectorGameMode::Tick(float DeltaSeconds) {
+
+	BATTERY_SCOPE_CYCLE_COUNTER(GameModeTick);
+
+	Super::Tick(DeltaSeconds);
+
+	//Only ticks once the match has started, so the first tick is the first playable frame
+	if(m_firstFrameTime <= 0.0) {
+		m_firstFrameTime = FPlatformTime::Seconds() - GStartTime;
+		StartupTimings();
+	}
+
+	if(m_botDecisions.GetBotCount() > 0) {
+		m_botDecisions.Update(m_pickupRegistry, GetWorld()->GetTimeSeconds(), DeltaSeconds);
+	}
+
+	//Spawning waits until a checkpoint's pickups are all back
+	if(m_restoreData.IsValid()) {
+		RestoreCheckpointPickups();
+		return;
+	}
+
+	RunDueSpawns();
+
+}
+
+void ABatteryCollectorGameMode::RunDueSpawns() {
+
+	const float now = GetWorld()->GetTimeSeconds();
+	m_spawnScheduler.Advance(now);
+
+	FSpawnSchedulerStats& stats = m_spawnScheduler.GetStats();
+	int32 spawnsThisFrame = 0;
+
+	while(m_spawnScheduler.GetReadyCount() > 0) {
+		//Whatever is still due waits for a later frame
+		if(spawnsThisFrame >= spawnBudgetPerFrame) {
+			stats.deferredByBudget += m_spawnScheduler.GetReadyCount();
+			break;
 		}
-		//otherwise if our power is positive
-		else if(myCharacter->GetCurrentPower() > 0) {
-			//Decrease power using decay rate
-			myCharacter->UpdatePower(-DeltaTime * decayRate * (myCharacter->GetInitialPower()));
+		if(maxLivePickups > 0 && GetLivePickupCount() >= maxLivePickups) {
+			stats.deferredByCap += m_spawnScheduler.GetReadyCount();
+			break;
+		}
+
+		float dueTime = 0.0f;
+		ASpawnVolume* const volume = m_spawnScheduler.PopReady(dueTime);
+		if(volume == nullptr) {
+			break;
+		}
+
+		volume->SpawnPickup();
+		spawnsThisFrame++;
+
+		const float lateness = now - dueTime;
+		stats.spawns++;
+		stats.totalLateness += lateness;
+		stats.maxLateness = FMath::Max(stats.maxLateness, lateness);
+
+		m_spawnScheduler.Schedule(volume, now + volume->RollSpawnDelay());
+	}
+
+	stats.peakBacklog = FMath::Max(stats.peakBacklog, m_spawnScheduler.GetReadyCount());
+	BATTERY_INC_COUNTER_BY(DeferredSpawns, m_spawnScheduler.GetReadyCount());
+
+}
+
+int32 ABatteryCollectorGameMode::GetLivePickupCount() const {
+	return m_pickupRegistry.Num() + (m_instanceField ? m_instanceField->GetInstanceCount() : 0);
+}
+
+void ABatteryCollectorGameMode::SetPlayerDefaults(APawn* PlayerPawn) {
+
+	Super::SetPlayerDefaults(PlayerPawn);
+
+	//Players joining a match that is already running
+	ABatteryCollectorCharacter* const character = Cast<ABatteryCollectorCharacter>(PlayerPawn);
+	if(character && m_currentState == eBatteryPlayState::ePlaying) {
+		StartPlayerPower(character);
+	}
+
+}
+
+void ABatteryCollectorGameMode::StartPlayerPower(ABatteryCollectorCharacter* character) {
+
+	const int32 index = m_playerPower.IndexOf(character);
+	if(index == INDEX_NONE) {
+		m_playerPower.Add(character, powerToWin);
+	} else {
+		//Back in the match after a checkpoint, whatever the last one left them as
+		m_playerPower.SetState(index, ePlayerPowerState::ePlaying);
+	}
+
+	//Start draining power and schedule the loss
+	character->SetPowerDecayRate(BatteryPowerSim::DecayPerSecond(decayRate, character->GetInitialPower()));
+	OnCharacterPowerChanged(character);
+
+}
+
+void ABatteryCollectorGameMode::OnCharacterPowerChanged(ABatteryCollectorCharacter* character) {
+
+	BATTERY_SCOPE_CYCLE_COUNTER(OnCharacterPowerChanged);
+
+	//Only players decide the match, and only while it is still being played
+	const int32 index = m_playerPower.IndexOf(character);
+	if(m_currentState != eBatteryPlayState::ePlaying || index == INDEX_NONE || m_playerPower.GetState(index) != ePlayerPowerState::ePlaying) {
+		return;
+	}
+
+	const float now = GetWorld()->GetTimeSeconds();
+	m_playerPower.SetPower(index, character->GetCurrentPower(), now, character->GetPowerDecayRate());
+
+	//Power only ever rises on a change, so this is the only place a win can happen
+	if(m_playerPower.HasWon(index, now)) {
+		m_playerPower.SetState(index, ePlayerPowerState::eWon);
+		OnPlayerWon.Broadcast(character);
+		SetCurrentState(eBatteryPlayState::eWon);
+		return;
+	}
+
+	//Otherwise the player's run-out time may have moved
+	if(BatteryPowerSim::HasRunOut(m_playerPower.GetPowerAt(index, now))) {
+		m_nextDepletionTime = now;
+		OnPowerDepleted();
+	} else {
+		ScheduleNextDepletion();
+	}
+
+}
+
+void ABatteryCollectorGameMode::RemovePlayer(ABatteryCollectorCharacter* character) {
+
+	const int32 index = m_playerPower.IndexOf(character);
+	if(index == INDEX_NONE) {
+		return;
+	}
+
+	m_playerPower.RemoveAt(index);
+
+	if(m_currentState == eBatteryPlayState::ePlaying) {
+		ScheduleNextDepletion();
+	}
+
+}
+
+void ABatteryCollectorGameMode::ScheduleNextDepletion() {
+
+	m_nextDepletionTime = m_playerPower.GetNextDepletionTime();
+	if(m_nextDepletionTime == MAX_flt) {
+		GetWorldTimerManager().ClearTimer(m_powerDepletedTimer);
+		return;
+	}
+
+	const float delay = FMath::Max(m_nextDepletionTime - GetWorld()->GetTimeSeconds(), KINDA_SMALL_NUMBER);
+	GetWorldTimerManager().SetTimer(m_powerDepletedTimer, this, &ABatteryCollectorGameMode::OnPowerDepleted, delay, false);
+
+}
+
+void ABatteryCollectorGameMode::OnPowerDepleted() {
+
+	if(m_currentState != eBatteryPlayState::ePlaying) {
+		return;
+	}
+
+	//The timer can land a hair before the time it was set for
+	const float now = FMath::Max(GetWorld()->GetTimeSeconds(), m_nextDepletionTime);
+
+	//One pass picks out everyone who has run out by now
+	TArray<int32> depleted;
+	m_playerPower.CollectDepleted(now, depleted);
+
+	for(const int32 index : depleted) {
+		HandlePlayerLost(m_playerPower.GetCharacter(index));
+	}
+
+	if(m_playerPower.CountPlaying() == 0) {
+		SetCurrentState(eBatteryPlayState::eGameOver);
+	} else {
+		ScheduleNextDepletion();
+	}
+
+}
+
+void ABatteryCollectorGameMode::HandlePlayerLost(ABatteryCollectorCharacter* character) {
+
+	character->SetPowerDecayRate(0.0f);
+
+	//block input
+	APlayerController* const player = Cast<APlayerController>(character->GetController());
+	if(player) {
+		if(player->IsLocalController()) {
+			player->SetCinematicMode(true, false, false, true, true);
 		} else {
-			SetCurrentState(eBatteryPlayState::eGameOver);
+			player->ClientSetCinematicMode(true, true, true, false);
 		}
+	}
+
+	//ragdoll
+	character->GetMesh()->SetSimulatePhysics(true);
+	character->GetMovementComponent()->MovementState.bCanJump = false;
+
+	OnPlayerLost.Broadcast(character);
+
+}
 
-		
+void ABatteryCollectorGameMode::StopPowerDecay() {
+
+	GetWorldTimerManager().ClearTimer(m_powerDepletedTimer);
+
+	for(int32 index = 0; index < m_playerPower.Num(); index++) {
+		m_playerPower.GetCharacter(index)->SetPowerDecayRate(0.0f);
 	}
 
 }
@@ -81,57 +580,652 @@ float ABatteryCollectorGameMode::GetPowerToWin() const {
 	return powerToWin;
 }
 
+int32 ABatteryCollectorGameMode::GetActivePickupCount() const {
+	return m_pickupRegistry.CountActive();
+}
+
 eBatteryPlayState ABatteryCollectorGameMode::GetCurrentState() const {
 	return m_currentState;
 }
 
 void ABatteryCollectorGameMode::SetCurrentState(eBatteryPlayState newState) {
 	m_currentState = newState;
+	FBatteryEventLog::LogStateChange(this, (uint8)newState);
 	HandleNewState(newState);
+	OnPlayStateChanged.Broadcast(newState);
 }
 
 void ABatteryCollectorGameMode::HandleNewState(eBatteryPlayState newState) {
 
+	BATTERY_SCOPE_CYCLE_COUNTER(HandleNewState);
+
 	switch(newState) {
 		case eBatteryPlayState::ePlaying:
 		{
-			//Spawn volumes active
+			//Spawn volumes active - each gets its first due time in the scheduler
 			for(auto volume : m_spawnVolumeActors) {
 				volume->SetSpawningActive(true);
 			}
+			SetActorTickEnabled(true);
+			//Volumes nobody is near are throttled or paused straight away
+			if(bUseSpawnSignificance) {
+				UpdateSpawnSignificance();
+				GetWorldTimerManager().SetTimer(m_significanceTimer, this, &ABatteryCollectorGameMode::UpdateSpawnSignificance, significanceInterval, true);
+			}
 		}
 			break;
 		case eBatteryPlayState::eWon: 
 		{
 			//Spawn volumes inactive
-			for(auto volume : m_spawnVolumeActors) {
-				volume->SetSpawningActive(false);
-			}
+			m_spawnScheduler.Clear();
+			SetActorTickEnabled(false);
+			GetWorldTimerManager().ClearTimer(m_significanceTimer);
+			StopPowerDecay();
 		}			
 			break;
 		case eBatteryPlayState::eGameOver:
 		{
 			//Spawn volumes inactive
-			for(auto volume : m_spawnVolumeActors) {
-				volume->SetSpawningActive(false);
+			m_spawnScheduler.Clear();
+			SetActorTickEnabled(false);
+			GetWorldTimerManager().ClearTimer(m_significanceTimer);
+			//Every player has already been blocked and ragdolled as they ran out
+			StopPowerDecay();
+		}			
+			break;
+		case eBatteryPlayState::eUnknown:
+			break;
+	}
+
+}
+
+void ABatteryCollectorGameMode::UpdateBatteryInstancing() {
+
+	if(m_instanceField == nullptr) {
+		return;
+	}
+
+	TArray<FVector> playerLocations;
+	GetPlayerLocations(playerLocations);
+
+	//Bring back batteries players are walking towards
+	m_instanceField->PromoteInRange(playerLocations, batteryPromoteRange);
+
+	//Then instance the resting ones nobody is near
+	TArray<int32> farSlots;
+	m_pickupRegistry.GatherSettledBeyond(playerLocations, FMath::Max(batteryDemoteRange, batteryPromoteRange), farSlots);
+
+	for(const int32 slot : farSlots) {
+		m_instanceField->DemoteBattery(Cast<ABatteryPickup>(m_pickupRegistry.GetProxy(slot)));
+	}
+
+}
+
+void ABatteryCollectorGameMode::GetPlayerLocations(TArray<FVector>& outLocations) const {
+
+	for(FConstPlayerControllerIterator iterator = GetWorld()->GetPlayerControllerIterator(); iterator; ++iterator) {
+		APawn* const pawn = iterator->Get() ? iterator->Get()->GetPawn() : nullptr;
+		if(pawn) {
+			outLocations.Add(pawn->GetActorLocation());
+		}
+	}
+
+}
+
+void ABatteryCollectorGameMode::UpdateSpawnSignificance() {
+
+	//Player cameras - bots don't count, nobody sees what they see
+	TArray<FVector> viewLocations;
+	TArray<FVector> viewDirections;
+	for(FConstPlayerControllerIterator iterator = GetWorld()->GetPlayerControllerIterator(); iterator; ++iterator) {
+		APlayerController* const controller = iterator->Get();
+		if(controller && controller->GetPawn()) {
+			viewLocations.Add(controller->GetPawn()->GetActorLocation());
+			viewDirections.Add(controller->GetControlRotation().Vector());
+		}
+	}
+
+	//Nobody to rank against yet, e.g. a server waiting for players - spawn as usual
+	if(viewLocations.Num() == 0) {
+		for(ASpawnVolume* const volume : m_spawnVolumeActors) {
+			volume->SetSignificance(eSpawnSignificance::eFull);
+		}
+		return;
+	}
+
+	const float inViewCos = FMath::Cos(FMath::DegreesToRadians(inViewHalfAngle));
+
+	for(ASpawnVolume* const volume : m_spawnVolumeActors) {
+		const FBox bounds = volume->GetSpawnBounds();
+
+		//Distance to the nearest player, shortened for players looking towards the volume
+		float nearest = MAX_flt;
+		for(int32 iPlayer = 0; iPlayer < viewLocations.Num(); iPlayer++) {
+			const float distance = FMath::Sqrt(bounds.ComputeSquaredDistanceToPoint(viewLocations[iPlayer]));
+			const FVector toVolume = (bounds.GetCenter() - viewLocations[iPlayer]).GetSafeNormal();
+			const bool bInView = bounds.IsInside(viewLocations[iPlayer]) || FVector::DotProduct(toVolume, viewDirections[iPlayer]) >= inViewCos;
+			nearest = FMath::Min(nearest, bInView ? distance / inViewRangeScale : distance);
+		}
+
+		if(nearest <= fullSignificanceRange) {
+			volume->SetSignificance(eSpawnSignificance::eFull);
+		} else if(nearest <= FMath::Max(pausedSignificanceRange, fullSignificanceRange)) {
+			volume->SetSignificance(eSpawnSignificance::eThrottled);
+		} else {
+			volume->SetSignificance(eSpawnSignificance::ePaused);
+		}
+	}
+
+}
+
+void ABatteryCollectorGameMode::SpawnSignificanceReport() {
+
+	int32 volumes[3] = {};
+	int32 pickups[3] = {};
+	float areas[3] = {};
+	FBox mapBounds(ForceInit);
+
+	for(ASpawnVolume* const volume : m_spawnVolumeActors) {
+		const int32 tier = (int32)volume->GetSignificance();
+		const FBox bounds = volume->GetSpawnBounds();
+		const FVector size = bounds.GetSize();
+		volumes[tier]++;
+		pickups[tier] += volume->GetPoolStats().inUse;
+		areas[tier] += size.X * size.Y;
+		mapBounds += bounds;
+	}
+
+	//Areas in square metres, the map is taken as the box around every spawn volume
+	const FVector mapSize = mapBounds.IsValid ? mapBounds.GetSize() : FVector::ZeroVector;
+	const float mapArea = mapSize.X * mapSize.Y / 10000.0f;
+	const TCHAR* const tierNames[3] = { TEXT("full"), TEXT("throttled"), TEXT("paused") };
+
+	UE_LOG(LogClass, Log, TEXT("SpawnSignificanceReport: %d volumes over a %.0f x %.0f m map (%.0f m2), %d live pickups"),
+		m_spawnVolumeActors.Num(), mapSize.X / 100.0f, mapSize.Y / 100.0f, mapArea, GetLivePickupCount());
+	for(int32 tier = 0; tier < 3; tier++) {
+		const float area = areas[tier] / 10000.0f;
+		UE_LOG(LogClass, Log, TEXT("  %-9s %4d volumes covering %8.0f m2 (%5.1f%% of the map), %5d pickups, %.2f pickups per 100 m2"),
+			tierNames[tier], volumes[tier], area, mapArea > 0.0f ? 100.0f * area / mapArea : 0.0f, pickups[tier],
+			area > 0.0f ? pickups[tier] * 100.0f / area : 0.0f);
+	}
+
+}
+
+void ABatteryCollectorGameMode::WakePickupsInRadius(FVector center, float radius) {
+
+	TArray<int32> slots;
+	m_pickupRegistry.QueryRadius(center, radius, slots);
+
+	for(const int32 slot : slots) {
+		m_pickupRegistry.GetProxy(slot)->WakeFromFreeze();
+	}
+
+}
+
+void ABatteryCollectorGameMode::InvalidateSpawnPointsInRadius(FVector center, float radius) {
+
+	for(ASpawnVolume* const volume : m_spawnVolumeActors) {
+		volume->InvalidateSpawnPoints(center, radius);
+	}
+
+}
+
+void ABatteryCollectorGameMode::BenchmarkPlayerPower(int32 iterations) {
+
+	if(iterations <= 0) {
+		return;
+	}
+
+	const int32 playerCounts[] = { 1, 8, 64, 256, 1024 };
+	FRandomStream random(1);
+
+	for(const int32 playerCount : playerCounts) {
+		FPlayerPowerTable table;
+		for(int32 iPlayer = 0; iPlayer < playerCount; iPlayer++) {
+			const int32 index = table.Add(nullptr, 2500.0f);
+			table.SetPower(index, random.FRandRange(500.0f, 2000.0f), 0.0f, random.FRandRange(10.0f, 30.0f));
+		}
+
+		//What a power change costs - copy one player's power in and find the next run-out time
+		float nextDepletion = 0.0f;
+		const double changeStart = FPlatformTime::Seconds();
+		for(int32 iRun = 0; iRun < iterations; iRun++) {
+			const int32 index = iRun % playerCount;
+			table.SetPower(index, 1000.0f + iRun % 7, 0.0f, 20.0f);
+			nextDepletion = table.GetNextDepletionTime();
+		}
+		const double changeTime = FPlatformTime::Seconds() - changeStart;
+
+		//What the depletion timer costs - pick out who ran out and count who is left
+		TArray<int32> depleted;
+		int32 playing = 0;
+		const double depletionStart = FPlatformTime::Seconds();
+		for(int32 iRun = 0; iRun < iterations; iRun++) {
+			depleted.Reset();
+			table.CollectDepleted(0.0f, depleted);
+			playing = table.CountPlaying();
+		}
+		const double depletionTime = FPlatformTime::Seconds() - depletionStart;
+
+		UE_LOG(LogClass, Log, TEXT("BenchmarkPlayerPower %5d players: power change %7.3f us, depletion pass %7.3f us (next run-out %.1f s, %d playing)"),
+			playerCount, changeTime * 1e6 / iterations, depletionTime * 1e6 / iterations, nextDepletion, playing);
+	}
+
+}
+
+void ABatteryCollectorGameMode::PickupRenderStats() {
+
+	//Every pickup actor draws its own mesh and owns a physics body
+	int32 proxyCount = 0;
+	int32 simulatingBodies = 0;
+	int32 awakeBodies = 0;
+	int32 frozenPickups = 0;
+
+	for(int32 slot = 0; slot < m_pickupRegistry.GetSlotCount(); slot++) {
+		APickup* const pickup = m_pickupRegistry.GetProxy(slot);
+		if(pickup == nullptr) {
+			continue;
+		}
+
+		proxyCount++;
+		if(pickup->GetMesh()->IsSimulatingPhysics()) {
+			simulatingBodies++;
+			if(pickup->GetMesh()->RigidBodyIsAwake()) {
+				awakeBodies++;
+			}
+		} else if(pickup->IsFrozen()) {
+			frozenPickups++;
+		}
+	}
+
+	//Instanced batteries share one draw call batch per mesh and have no bodies
+	const int32 instanceCount = m_instanceField ? m_instanceField->GetInstanceCount() : 0;
+	const int32 instancedComponents = m_instanceField ? m_instanceField->GetInstancedComponentCount() : 0;
+
+	UE_LOG(LogClass, Log, TEXT("PickupRenderStats: %d pickup actors (%d simulating bodies, %d awake, %d frozen), %d instanced batteries in %d instanced components, last physics step %.3f ms"),
+		proxyCount, simulatingBodies, awakeBodies, frozenPickups, instanceCount, instancedComponents, m_physicsStepTimer.GetLastStepMs());
+
+}
+
+void ABatteryCollectorGameMode::SpawnSchedulerStats(bool bReset) {
+
+	const FSpawnSchedulerStats& stats = m_spawnScheduler.GetStats();
+
+	UE_LOG(LogClass, Log, TEXT("SpawnSchedulerStats: %d volumes scheduled, %d due now, %d spawns, deferred %d by budget and %d by cap, peak backlog %d, lateness avg %.3f s max %.3f s"),
+		m_spawnScheduler.Num(), m_spawnScheduler.GetReadyCount(), stats.spawns, stats.deferredByBudget, stats.deferredByCap, stats.peakBacklog,
+		stats.spawns > 0 ? stats.totalLateness / stats.spawns : 0.0, stats.maxLateness);
+
+	if(bReset) {
+		m_spawnScheduler.GetStats() = FSpawnSchedulerStats();
+	}
+
+}
+
+void ABatteryCollectorGameMode::SpawnPointStats() {
+
+	FSpawnPointCacheStats totals;
+
+	for(ASpawnVolume* const volume : m_spawnVolumeActors) {
+		const FSpawnPointCacheStats stats = volume->GetSpawnPointStats();
+		UE_LOG(LogClass, Log, TEXT("SpawnPointStats %s: %d cached, %d tested, %d rejected (%.1f%%), %d drawn, %d fallbacks, built in %.3f s"),
+			*volume->GetName(), stats.cached, stats.tested, stats.rejected, stats.tested > 0 ? 100.0f * stats.rejected / stats.tested : 0.0f,
+			stats.drawn, stats.fallbacks, stats.buildSeconds);
+
+		totals.cached += stats.cached;
+		totals.tested += stats.tested;
+		totals.rejected += stats.rejected;
+		totals.drawn += stats.drawn;
+		totals.fallbacks += stats.fallbacks;
+		totals.buildSeconds = FMath::Max(totals.buildSeconds, stats.buildSeconds);
+	}
+
+	UE_LOG(LogClass, Log, TEXT("SpawnPointStats total: %d volumes, %d cached, %d tested, %d rejected (%.1f%%), %d drawn, %d fallbacks, slowest build %.3f s"),
+		m_spawnVolumeActors.Num(), totals.cached, totals.tested, totals.rejected, totals.tested > 0 ? 100.0f * totals.rejected / totals.tested : 0.0f,
+		totals.drawn, totals.fallbacks, totals.buildSeconds);
+
+}
+
+void ABatteryCollectorGameMode::SaveCheckpoint(const FString& name) {
+
+	const double startTime = FPlatformTime::Seconds();
+
+	TSharedRef<FCheckpointData, ESPMode::ThreadSafe> data = MakeShareable(new FCheckpointData());
+	CaptureCheckpoint(*data);
+
+	UE_LOG(LogClass, Log, TEXT("Checkpoint %s: %d pickups captured in %.2f ms on the game thread"), *name, data->pickups.Num(), (FPlatformTime::Seconds() - startTime) * 1000.0);
+
+	FBatteryCheckpoint::SaveAsync(name, data);
+
+}
+
+void ABatteryCollectorGameMode::Autosave() {
+
+	//A decided match isn't worth recovering
+	if(m_currentState == eBatteryPlayState::ePlaying && !m_restoreData.IsValid()) {
+		SaveCheckpoint(TEXT("Autosave"));
+	}
+
+}
+
+void ABatteryCollectorGameMode::CaptureCheckpoint(FCheckpointData& outData) const {
+
+	const float now = GetWorld()->GetTimeSeconds();
+
+	outData.playState = (uint8)m_currentState;
+	outData.gameTime = now;
+
+	for(FConstPlayerControllerIterator iterator = GetWorld()->GetPlayerControllerIterator(); iterator; ++iterator) {
+		ABatteryCollectorCharacter* const character = iterator->Get() ? Cast<ABatteryCollectorCharacter>(iterator->Get()->GetPawn()) : nullptr;
+		outData.playerPower.Add(character ? character->GetCurrentPower() : 0.0f);
+	}
+
+	outData.volumeNames.Reserve(m_spawnVolumeActors.Num());
+	outData.spawnPhases.Reserve(m_spawnVolumeActors.Num());
+	for(int32 iVolume = 0; iVolume < m_spawnVolumeActors.Num(); iVolume++) {
+		ASpawnVolume* const volume = m_spawnVolumeActors[iVolume];
+		float dueTime = 0.0f;
+		outData.volumeNames.Add(FCrc::StrCrc32(*volume->GetName()));
+		outData.spawnPhases.Add(m_spawnScheduler.FindDueTime(volume, dueTime) ? FMath::Max(dueTime - now, 0.0f) : -1.0f);
+
+		for(int32 iPool = 0; iPool < volume->GetPoolCount(); iPool++) {
+			const UPickupPool* const pool = volume->GetPoolAt(iPool);
+			if(pool == nullptr) {
+				continue;
 			}
-			//block input
-			APlayerController* player = UGameplayStatics::GetPlayerController(this, 0);
-			if(player) {
-				player->SetCinematicMode(true, false, false, true, true);
+
+			for(APickup* const pickup : pool->GetPickupsInUse()) {
+				if(pickup == nullptr) {
+					continue;
+				}
+
+				ABatteryPickup* const battery = Cast<ABatteryPickup>(pickup);
+				FCheckpointPickup record;
+				record.volume = (uint16)iVolume;
+				record.pool = (uint8)iPool;
+				record.bActive = pickup->IsActive();
+				record.power = battery ? battery->GetPower() : 0.0f;
+				record.location = pickup->GetActorLocation();
+				record.rotation = pickup->GetActorRotation();
+				outData.pickups.Add(record);
 			}
+		}
+	}
+
+	//Instanced batteries are saved as the batteries they stand for
+	if(m_instanceField) {
+		TArray<FTransform> transforms;
+		TArray<float> power;
+		TArray<UPickupPool*> pools;
+		m_instanceField->GetInstancedBatteries(transforms, power, pools);
 
-			//ragdoll
-			ACharacter* myCharacter = UGameplayStatics::GetPlayerCharacter(this, 0);
-			if(myCharacter) {
-				myCharacter->GetMesh()->SetSimulatePhysics(true);
-				myCharacter->GetMovementComponent()->MovementState.bCanJump = false;
+		for(int32 iBattery = 0; iBattery < transforms.Num(); iBattery++) {
+			ASpawnVolume* const volume = pools[iBattery] ? Cast<ASpawnVolume>(pools[iBattery]->GetOuter()) : nullptr;
+			const int32 volumeIndex = m_spawnVolumeActors.IndexOfByKey(volume);
+			if(volumeIndex == INDEX_NONE) {
+				continue;
 			}
 
-		}			
+			FCheckpointPickup record;
+			record.volume = (uint16)volumeIndex;
+			record.pool = (uint8)volume->FindPoolIndex(pools[iBattery]);
+			record.bActive = true;
+			record.power = power[iBattery];
+			record.location = transforms[iBattery].GetLocation();
+			record.rotation = transforms[iBattery].Rotator();
+			outData.pickups.Add(record);
+		}
+	}
+
+}
+
+void ABatteryCollectorGameMode::LoadCheckpoint(const FString& name) {
+
+	TUniquePtr<FCheckpointData> data(new FCheckpointData());
+	const double loadStart = FPlatformTime::Seconds();
+	if(!FBatteryCheckpoint::Load(name, *data)) {
+		return;
+	}
+	const double loadTime = FPlatformTime::Seconds() - loadStart;
+
+	//Clear the level - every pooled pickup goes back to its pool, instanced ones are already there
+	if(m_instanceField) {
+		m_instanceField->ClearInstances();
+	}
+	for(ASpawnVolume* const volume : m_spawnVolumeActors) {
+		volume->DeactivatePickups();
+	}
+
+	//Players take on their saved power straight away
+	int32 iPlayer = 0;
+	for(FConstPlayerControllerIterator iterator = GetWorld()->GetPlayerControllerIterator(); iterator && iPlayer < data->playerPower.Num(); ++iterator, ++iPlayer) {
+		ABatteryCollectorCharacter* const character = iterator->Get() ? Cast<ABatteryCollectorCharacter>(iterator->Get()->GetPawn()) : nullptr;
+		if(character) {
+			character->UpdatePower(data->playerPower[iPlayer] - character->GetCurrentPower(), ePowerChangeReason::eExternal);
+		}
+	}
+
+	//Volumes are matched by name, and pick up their spawn timers where they were
+	m_restoreVolumes.Reset();
+	for(int32 iVolume = 0; iVolume < data->volumeNames.Num(); iVolume++) {
+		m_restoreVolumes.Add(m_spawnVolumeActors.IndexOfByPredicate([&](const ASpawnVolume* volume) {
+			return FCrc::StrCrc32(*volume->GetName()) == data->volumeNames[iVolume];
+		}));
+	}
+	ApplyCheckpointSpawnPhases(*data);
+
+	UE_LOG(LogClass, Log, TEXT("Checkpoint %s: read %d pickups in %.2f ms, restoring at %.1f ms a frame"), *name, data->pickups.Num(), loadTime * 1000.0, checkpointRestoreBudgetMs);
+
+	m_restoreData = MoveTemp(data);
+	m_restoreCursor = 0;
+	m_restoreFrames = 0;
+	m_restoreMaxFrameMs = 0.0f;
+	m_restoreStart = FPlatformTime::Seconds();
+
+	//Pickups come back from Tick, which only runs while playing
+	SetActorTickEnabled(true);
+
+}
+
+void ABatteryCollectorGameMode::RestoreCheckpointPickups() {
+
+	const double frameStart = FPlatformTime::Seconds();
+	const double frameEnd = frameStart + checkpointRestoreBudgetMs / 1000.0;
+	const TArray<FCheckpointPickup>& pickups = m_restoreData->pickups;
+
+	while(m_restoreCursor < pickups.Num()) {
+		//Checking the clock costs more than a pickup, so only look every few
+		if((m_restoreCursor & 15) == 0 && FPlatformTime::Seconds() >= frameEnd) {
 			break;
-		case eBatteryPlayState::eUnknown:
+		}
+
+		const FCheckpointPickup& record = pickups[m_restoreCursor];
+		const int32 volumeIndex = m_restoreVolumes.IsValidIndex(record.volume) ? m_restoreVolumes[record.volume] : INDEX_NONE;
+		ASpawnVolume* const volume = volumeIndex != INDEX_NONE ? m_spawnVolumeActors[volumeIndex] : nullptr;
+		UPickupPool* const pool = volume ? volume->GetPoolAt(record.pool) : nullptr;
+
+		//Its pickup type is still streaming in, carry on next frame
+		if(pool == nullptr && volume && volume->IsLoadingPickupTypes()) {
 			break;
+		}
+
+		m_restoreCursor++;
+
+		//Collected pickups are back in their pool already
+		if(pool == nullptr || !record.bActive) {
+			continue;
+		}
+
+		APickup* const pickup = pool->Acquire(record.location, record.rotation);
+		ABatteryPickup* const battery = Cast<ABatteryPickup>(pickup);
+		if(battery) {
+			battery->SetPower(record.power);
+		}
+		if(pickup) {
+			//Saved where it lay, don't let it fall again
+			pickup->Settle();
+			FBatteryEventLog::LogSpawn(pickup);
+		}
+	}
+
+	m_restoreFrames++;
+	m_restoreMaxFrameMs = FMath::Max(m_restoreMaxFrameMs, (float)((FPlatformTime::Seconds() - frameStart) * 1000.0));
+
+	if(m_restoreCursor < pickups.Num()) {
+		return;
+	}
+
+	UE_LOG(LogClass, Log, TEXT("Checkpoint restored: %d pickups over %d frames, %.2f ms in all, at most %.2f ms a frame"),
+		pickups.Num(), m_restoreFrames, (FPlatformTime::Seconds() - m_restoreStart) * 1000.0, m_restoreMaxFrameMs);
+
+	//Taken off the game mode first, so the state change below sees the restore as finished
+	const TUniquePtr<FCheckpointData> data = MoveTemp(m_restoreData);
+	const eBatteryPlayState savedState = (eBatteryPlayState)data->playState;
+
+	if(savedState != m_currentState) {
+		SetCurrentState(savedState);
+		//Playing again rolls every volume a new delay, the checkpoint's own go back on top
+		if(savedState == eBatteryPlayState::ePlaying) {
+			ApplyCheckpointSpawnPhases(*data);
+		}
+	} else if(m_currentState != eBatteryPlayState::ePlaying) {
+		SetActorTickEnabled(false);
+	}
+
+	//Players who had won, lost or stopped when the match ended play on from their saved power
+	if(savedState == eBatteryPlayState::ePlaying) {
+		int32 iPlayer = 0;
+		for(FConstPlayerControllerIterator iterator = GetWorld()->GetPlayerControllerIterator(); iterator && iPlayer < data->playerPower.Num(); ++iterator, ++iPlayer) {
+			ABatteryCollectorCharacter* const character = iterator->Get() ? Cast<ABatteryCollectorCharacter>(iterator->Get()->GetPawn()) : nullptr;
+			if(character) {
+				StartPlayerPower(character);
+			}
+		}
+	}
+
+}
+
+void ABatteryCollectorGameMode::ApplyCheckpointSpawnPhases(const FCheckpointData& data) {
+
+	const float now = GetWorld()->GetTimeSeconds();
+	for(int32 iVolume = 0; iVolume < m_restoreVolumes.Num() && iVolume < data.spawnPhases.Num(); iVolume++) {
+		ASpawnVolume* const volume = m_restoreVolumes[iVolume] != INDEX_NONE ? m_spawnVolumeActors[m_restoreVolumes[iVolume]] : nullptr;
+		if(volume && data.spawnPhases[iVolume] >= 0.0f && volume->GetSignificance() != eSpawnSignificance::ePaused) {
+			m_spawnScheduler.Schedule(volume, now + data.spawnPhases[iVolume]);
+		} else if(volume) {
+			m_spawnScheduler.Cancel(volume);
+		}
+	}
+
+}
+
+void ABatteryCollectorGameMode::BenchmarkCheckpoint(int32 pickupCount) {
+
+	if(pickupCount <= 0) {
+		return;
 	}
 
+	//A level of the given size, pickups spread over every volume
+	FRandomStream random(1);
+	FCheckpointData data;
+	data.playState = (uint8)eBatteryPlayState::ePlaying;
+	data.playerPower.Init(1500.0f, 4);
+	const int32 volumeCount = FMath::Max(m_spawnVolumeActors.Num(), 1);
+	for(int32 iVolume = 0; iVolume < volumeCount; iVolume++) {
+		data.volumeNames.Add(iVolume);
+		data.spawnPhases.Add(random.FRandRange(0.0f, 4.5f));
+	}
+	data.pickups.SetNumUninitialized(pickupCount);
+	for(int32 iPickup = 0; iPickup < pickupCount; iPickup++) {
+		FCheckpointPickup& record = data.pickups[iPickup];
+		record.volume = (uint16)(iPickup % volumeCount);
+		record.pool = 0;
+		record.bActive = true;
+		record.power = 150.0f;
+		record.location = random.GetUnitVector() * 10000.0f;
+		record.rotation = FRotator(random.FRandRange(-180.0f, 180.0f), random.FRandRange(-180.0f, 180.0f), random.FRandRange(-180.0f, 180.0f));
+	}
+
+	const double saveStart = FPlatformTime::Seconds();
+	const int32 size = FBatteryCheckpoint::Save(TEXT("Benchmark"), data);
+	const double saveTime = FPlatformTime::Seconds() - saveStart;
+
+	FCheckpointData loaded;
+	const double loadStart = FPlatformTime::Seconds();
+	const bool bLoaded = FBatteryCheckpoint::Load(TEXT("Benchmark"), loaded);
+	const double loadTime = FPlatformTime::Seconds() - loadStart;
+
+	//Capture is the only part of a save the game thread waits for
+	FCheckpointData live;
+	const double captureStart = FPlatformTime::Seconds();
+	CaptureCheckpoint(live);
+	const double captureTime = FPlatformTime::Seconds() - captureStart;
+
+	UE_LOG(LogClass, Log, TEXT("BenchmarkCheckpoint %d pickups: %d bytes (%.1f per pickup), save %.2f ms, load %.2f ms%s; capturing this level's %d pickups %.2f ms"),
+		pickupCount, size, (float)size / pickupCount, saveTime * 1000.0, loadTime * 1000.0, bLoaded && loaded.pickups.Num() == pickupCount ? TEXT("") : TEXT(" (read back FAILED)"),
+		live.pickups.Num(), captureTime * 1000.0);
+
+}
+
+void ABatteryCollectorGameMode::StartStatsCsv(float samplesPerSecond) {
+
+	if(samplesPerSecond <= 0.0f) {
+		return;
+	}
+
+	StopStatsCsv();
+
+	if(m_statsCsv.Open()) {
+		GetWorldTimerManager().SetTimer(m_statsCsvTimer, this, &ABatteryCollectorGameMode::SampleStatsCsv, 1.0f / samplesPerSecond, true);
+		UE_LOG(LogClass, Log, TEXT("Sampling stats %.1f times a second to %s"), samplesPerSecond, *m_statsCsv.GetPath());
+	}
+
+}
+
+void ABatteryCollectorGameMode::StopStatsCsv() {
+
+	GetWorldTimerManager().ClearTimer(m_statsCsvTimer);
+
+	if(m_statsCsv.IsOpen()) {
+		UE_LOG(LogClass, Log, TEXT("Stats CSV written to %s"), *m_statsCsv.GetPath());
+		m_statsCsv.Close();
+	}
+
+}
+
+void ABatteryCollectorGameMode::SampleStatsCsv() {
+	m_statsCsv.Sample(GetWorld()->GetTimeSeconds());
+}
+
+void ABatteryCollectorGameMode::StartNetReport(float intervalSeconds) {
+
+	if(intervalSeconds <= 0.0f || GetNetMode() == NM_Standalone) {
+		return;
+	}
+
+	StopNetReport();
+
+	if(m_netReport.Open()) {
+		GetWorldTimerManager().SetTimer(m_netReportTimer, this, &ABatteryCollectorGameMode::SampleNetReport, intervalSeconds, true);
+		UE_LOG(LogClass, Log, TEXT("Sampling client bandwidth every %.1f s to %s"), intervalSeconds, *m_netReport.GetPath());
+	}
+
+}
+
+void ABatteryCollectorGameMode::StopNetReport() {
+
+	GetWorldTimerManager().ClearTimer(m_netReportTimer);
+	m_netReport.Close();
+
+}
+
+void ABatteryCollectorGameMode::SampleNetReport() {
+	m_netReport.Sample(GetWorld());
+}
+
+void ABatteryCollectorGameMode::StartEventLog() {
+	FBatteryEventLog::Start();
+}
+
+void ABatteryCollectorGameMode::StopEventLog() {
+	FBatteryEventLog::Stop();
 }
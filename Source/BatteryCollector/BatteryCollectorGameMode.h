@@ -1,6 +1,14 @@
 // Copyright 1998-2017 Epic Games, Inc. All Rights Reserved.
 #pragma once
 #include "GameFramework/GameModeBase.h"
+#include "PickupRegistry.h"
+#include "BatteryCollectorStats.h"
+#include "SpawnScheduler.h"
+#include "NetBandwidthReport.h"
+#include "PlayerPowerTable.h"
+#include "BatteryCheckpoint.h"
+#include "BotDecisionSystem.h"
+#include "InputRecording.h"
 #include "BatteryCollectorGameMode.generated.h"
 
 //Enum to store gameplay state
@@ -12,6 +20,9 @@ enum class eBatteryPlayState : uint8 {
 	eUnknown
 };
 
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FBatteryPlayerEvent, class ABatteryCollectorCharacter*, character);
+DECLARE_MULTICAST_DELEGATE_OneParam(FBatteryPlayStateEvent, eBatteryPlayState);
+
 UCLASS(minimalapi)
 class ABatteryCollectorGameMode : public AGameModeBase
 {
@@ -20,9 +31,23 @@ class ABatteryCollectorGameMode : public AGameModeBase
 public:
 	ABatteryCollectorGameMode();
 
+	//Starts the startup timings, the map package has loaded by now
+	virtual void InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage) override;
+
+	virtual void PostInitializeComponents() override;
+
 	virtual void BeginPlay() override;
 
-	virtual void Tick(float DeltaTime) override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	//Only ticks while the match is being played, to run due spawns
+	virtual void Tick(float DeltaSeconds) override;
+
+	//Starts the power of players who spawn once the match is running
+	virtual void SetPlayerDefaults(APawn* PlayerPawn) override;
+
+	//Players logging in during the startup preload get their pawns once it is done
+	virtual bool PlayerCanRestart_Implementation(APlayerController* Player) override;
 
 	//Returns power needed to win - Needed for HUD
 	UFUNCTION(BlueprintPure, Category = "Power")
@@ -35,6 +60,136 @@ public:
 	//Set new play state
 	void SetCurrentState(eBatteryPlayState newState);
 
+	//Called by a character whenever its power jumps - checks for a win and re-schedules the loss
+	void OnCharacterPowerChanged(class ABatteryCollectorCharacter* character);
+
+	//A player's character is leaving the level
+	void RemovePlayer(class ABatteryCollectorCharacter* character);
+
+	//A player went past the power needed to win, which ends the match
+	UPROPERTY(BlueprintAssignable, Category = "Power")
+	FBatteryPlayerEvent OnPlayerWon;
+
+	//A player ran out of power, the match is over once every player has
+	UPROPERTY(BlueprintAssignable, Category = "Power")
+	FBatteryPlayerEvent OnPlayerLost;
+
+	//The play state changed, after the game mode has handled it
+	FBatteryPlayStateEvent OnPlayStateChanged;
+
+	//State of every pickup in the level
+	FORCEINLINE FPickupRegistry& GetPickupRegistry() { return m_pickupRegistry; }
+
+	//Next spawn time of every spawn volume
+	FORCEINLINE FSpawnScheduler& GetSpawnScheduler() { return m_spawnScheduler; }
+
+	//Number of pickups in the level that can still be collected
+	UFUNCTION(BlueprintPure, Category = "Pickups")
+	int32 GetActivePickupCount() const;
+
+	//Target selection for every collector bot
+	FORCEINLINE FBotDecisionSystem& GetBotDecisions() { return m_botDecisions; }
+
+	//Running totals of pickups spawned and collected this match
+	FORCEINLINE int32 GetPickupsSpawned() const { return m_pickupsSpawned; }
+	FORCEINLINE int32 GetPickupsCollected() const { return m_pickupsCollected; }
+	FORCEINLINE void RecordPickupSpawned() { m_pickupsSpawned++; }
+	FORCEINLINE void RecordPickupsCollected(int32 count) { m_pickupsCollected += count; }
+
+	//Spawn volumes add themselves as they begin play and take themselves out as they end it
+	void RegisterSpawnVolume(class ASpawnVolume* volume);
+	void UnregisterSpawnVolume(class ASpawnVolume* volume);
+
+	//True from the start of play until the startup preload is done and the match has started
+	FORCEINLINE bool IsPreloading() const { return m_bPreloading; }
+
+	//The session's input recording or replay, null when there is none. Handed to each pawn the first player possesses
+	FInputRecording* GetInputRecording();
+
+	//Wake every frozen pickup in the sphere, for explosions and other area effects
+	UFUNCTION(BlueprintCallable, Category = "Pickups")
+	void WakePickupsInRadius(FVector center, float radius);
+
+	//Drop cached spawn points in the sphere from every volume, for when level geometry moves or is placed there
+	UFUNCTION(BlueprintCallable, Category = "Spawning")
+	void InvalidateSpawnPointsInRadius(FVector center, float radius);
+
+	//Console command - times bot target selection on one thread and on the task graph for 1 to 500 bots
+	UFUNCTION(Exec)
+	void BenchmarkBotDecisions(int32 iterations = 50);
+
+	//Console command - prints how long startup took, from launch to the first playable frame
+	UFUNCTION(Exec)
+	void StartupTimings();
+
+	//Console command - times the batched player power passes for growing player counts
+	UFUNCTION(Exec)
+	void BenchmarkPlayerPower(int32 iterations = 1000);
+
+	//Console command - logs pickup actors, physics bodies, frozen pickups, the last physics step and instanced batteries
+	//for draw call and physics comparisons
+	UFUNCTION(Exec)
+	void PickupRenderStats();
+
+	//Console command - logs spawns run and put off by the spawn scheduler, reset clears the counters
+	UFUNCTION(Exec)
+	void SpawnSchedulerStats(bool bReset = false);
+
+	//Console command - logs how many spawn volumes are full, throttled and paused and the pickups they hold, against
+	//the area the volumes cover
+	UFUNCTION(Exec)
+	void SpawnSignificanceReport();
+
+	//Console command - logs each volume's spawn point cache: points checked and rejected, draws, fallbacks and build time
+	UFUNCTION(Exec)
+	void SpawnPointStats();
+
+	//Console command - samples the BatteryCollector stats into a CSV in Saved/Profiling/BatteryStats until stopped.
+	//Headless runs can start it with -BatteryStatsCsv=N instead
+	UFUNCTION(Exec)
+	void StartStatsCsv(float samplesPerSecond = 10.0f);
+
+	//Console command - closes the stats CSV
+	UFUNCTION(Exec)
+	void StopStatsCsv();
+
+	//Console command - samples each client connection's bandwidth into a CSV in Saved/Profiling/NetBandwidth until stopped.
+	//Servers can start it with -NetBandwidthReport=Seconds instead
+	UFUNCTION(Exec)
+	void StartNetReport(float intervalSeconds = 1.0f);
+
+	//Console command - closes the bandwidth CSV and logs a summary per client
+	UFUNCTION(Exec)
+	void StopNetReport();
+
+	//Console command - logs spawns, collections, power and state changes to a binary file in Saved/Profiling/BatteryEvents
+	//until stopped. Headless runs can start it with -BatteryEventLog
+	UFUNCTION(Exec)
+	void StartEventLog();
+
+	//Console command - flushes and closes the event log
+	UFUNCTION(Exec)
+	void StopEventLog();
+
+	//Console command - saves the match to Saved/Checkpoints/<name>.bccp, the file is written off the game thread
+	UFUNCTION(Exec)
+	void SaveCheckpoint(const FString& name = TEXT("Quick"));
+
+	//Console command - restores a saved match, pickups come back over as many frames as the restore budget needs.
+	//Benchmarks can start from one with -BatteryCheckpoint=Name
+	UFUNCTION(Exec)
+	void LoadCheckpoint(const FString& name = TEXT("Quick"));
+
+	//Copy the match into a checkpoint
+	void CaptureCheckpoint(FCheckpointData& outData) const;
+
+	//Pickups from a loaded checkpoint are still coming back
+	FORCEINLINE bool IsRestoringCheckpoint() const { return m_restoreData.IsValid(); }
+
+	//Console command - times writing and reading a checkpoint holding the given number of pickups
+	UFUNCTION(Exec)
+	void BenchmarkCheckpoint(int32 pickupCount = 10000);
+
 protected:
 	//Rate that player loses power
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Power", meta = (BlueprintProtected = "true"))
@@ -44,7 +199,7 @@ protected:
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Power", meta = (BlueprintProtected = "true"))
 	float powerToWin;
 
-	//The widget class to use for our HUD
+	//The widget class to use for our HUD - derive it from UBatteryHUDWidget so it is pushed power changes instead of polling
 	UPROPERTY(EditDefaultsOnly, BlueprintReadWrite, Category = "Power", meta = (BlueprintProtected = "true"))
 	TSubclassOf<class UUserWidget> HUDWidgetClass;
 
@@ -52,6 +207,91 @@ protected:
 	UPROPERTY()
 	class UUserWidget* CurrentWidget;
 
+	//Seconds between a bot's choices of which battery to go for
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Bots", meta = (ClampMin = "0.0"))
+	float botDecisionInterval;
+
+	//Bots only go for batteries this close, farther than that they wander
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Bots", meta = (ClampMin = "1.0"))
+	float botSearchRadius;
+
+	//Choose bot targets on task graph workers rather than on the game thread
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Bots")
+	bool bParallelBotDecisions;
+
+	//Pawn for players, streamed in by the startup preload instead of loading with this class. Replaces DefaultPawnClass when set
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Startup")
+	TAssetSubclassOf<APawn> playerPawnClass;
+
+	//Anything else to have in memory before the match starts, e.g. effects first played when something is collected
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Startup")
+	TArray<FStringAssetReference> preloadAssets;
+
+	//Edge length of a cell in the pickup registry's spatial index, about twice the collection radius works well
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Pickups", meta = (ClampMin = "1.0"))
+	float pickupIndexCellSize;
+
+	//Draw settled batteries far from every player as mesh instances without physics. Standalone games only, the
+	//instances aren't replicated
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Pickups|Instancing")
+	bool bInstanceDistantBatteries;
+
+	//Instanced batteries closer than this to a player become actors again
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Pickups|Instancing", meta = (ClampMin = "0.0"))
+	float batteryPromoteRange;
+
+	//Settled batteries farther than this from every player become instances - keep it above the promote range
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Pickups|Instancing", meta = (ClampMin = "0.0"))
+	float batteryDemoteRange;
+
+	//Seconds between instancing passes
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Pickups|Instancing", meta = (ClampMin = "0.01"))
+	float batteryInstancingInterval;
+
+	//Most spawn volumes that may spawn in one frame, the rest wait for the next frame
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Spawning", meta = (ClampMin = "1"))
+	int32 spawnBudgetPerFrame;
+
+	//Spawning pauses while this many pickups are in the level, 0 for no limit
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Spawning", meta = (ClampMin = "0"))
+	int32 maxLivePickups;
+
+	//Length of a slot in the spawn scheduler's timing wheel
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Spawning", meta = (ClampMin = "0.01"))
+	float spawnSchedulerResolution;
+
+	//Throttle and pause spawn volumes no player is near
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Spawning|Significance")
+	bool bUseSpawnSignificance;
+
+	//Volumes within this distance of a player spawn at their full rate
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Spawning|Significance", meta = (ClampMin = "0.0"))
+	float fullSignificanceRange;
+
+	//Volumes farther than this from every player are paused, the ones in between are throttled
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Spawning|Significance", meta = (ClampMin = "0.0"))
+	float pausedSignificanceRange;
+
+	//Both ranges stretch by this much for volumes in front of a player's camera
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Spawning|Significance", meta = (ClampMin = "1.0"))
+	float inViewRangeScale;
+
+	//Half angle of the view cone that counts as in front of the camera, in degrees
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Spawning|Significance", meta = (ClampMin = "0.0", ClampMax = "180.0"))
+	float inViewHalfAngle;
+
+	//Seconds between significance passes
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Spawning|Significance", meta = (ClampMin = "0.01"))
+	float significanceInterval;
+
+	//Milliseconds a frame may spend bringing back pickups from a checkpoint
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Checkpoint", meta = (ClampMin = "0.1"))
+	float checkpointRestoreBudgetMs;
+
+	//Seconds between automatic "Autosave" checkpoints for crash recovery, 0 to not save automatically
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Checkpoint", meta = (ClampMin = "0.0"))
+	float checkpointAutosaveInterval;
+
 private:
 
 	//Keeps track of the current play state
@@ -59,9 +299,114 @@ private:
 
 	TArray<class ASpawnVolume*> m_spawnVolumeActors;
 
+	FPickupRegistry m_pickupRegistry;
+
+	FSpawnScheduler m_spawnScheduler;
+
+	FBotDecisionSystem m_botDecisions;
+
+	//Run due spawns within the frame budget and the live pickup cap
+	void RunDueSpawns();
+
+	//Pickups in the level, as actors or instances
+	int32 GetLivePickupCount() const;
+
+	int32 m_pickupsSpawned;
+	int32 m_pickupsCollected;
+
+	//Draws far away batteries when instancing is on
+	UPROPERTY()
+	class ABatteryInstanceField* m_instanceField;
+
+	FTimerHandle m_instancingTimer;
+
+	//Swap far batteries for instances and near instances for batteries
+	void UpdateBatteryInstancing();
+
+	//Where every player pawn is
+	void GetPlayerLocations(TArray<FVector>& outLocations) const;
+
+	FTimerHandle m_significanceTimer;
+
+	//Rank every spawn volume by its distance to and visibility from the players and throttle or pause it to match
+	void UpdateSpawnSignificance();
+
 	//Handle any function calls that rely upon game state changes
 	void HandleNewState(eBatteryPlayState newState);
 
+	//Power of every player
+	FPlayerPowerTable m_playerPower;
+
+	//One per session, so respawns carry on the same recording rather than reopening the file
+	FInputRecording m_inputRecording;
+
+	//Fires when the next player's decaying power runs out
+	FTimerHandle m_powerDepletedTimer;
+	float m_nextDepletionTime;
+
+	void OnPowerDepleted();
+
+	//Point the depletion timer at whichever player runs out first
+	void ScheduleNextDepletion();
+
+	//Take a player who ran out of power out of the match
+	void HandlePlayerLost(class ABatteryCollectorCharacter* character);
+
+	//Freeze every player's power once the match is decided
+	void StopPowerDecay();
+
+	//Start a player's power draining
+	void StartPlayerPower(class ABatteryCollectorCharacter* character);
+
+	FBatteryStatsCsv m_statsCsv;
+
+	FTimerHandle m_statsCsvTimer;
+
+	FBatteryPhysicsStepTimer m_physicsStepTimer;
+
+	FNetBandwidthReport m_netReport;
+
+	FTimerHandle m_netReportTimer;
+
+	void SampleNetReport();
+
+	void SampleStatsCsv();
+
+	//Checkpoint being restored, its pickups come back a frame budget at a time
+	TUniquePtr<FCheckpointData> m_restoreData;
+	//Index into m_spawnVolumeActors of each checkpoint volume, INDEX_NONE for volumes no longer in the level
+	TArray<int32> m_restoreVolumes;
+	int32 m_restoreCursor;
+	int32 m_restoreFrames;
+	double m_restoreStart;
+	float m_restoreMaxFrameMs;
+
+	//Bring back pickups until the frame budget is spent, then finish the restore once they are all back
+	void RestoreCheckpointPickups();
+
+	//Schedule each restored volume's next spawn the checkpoint's phase from now
+	void ApplyCheckpointSpawnPhases(const FCheckpointData& data);
+
+	FTimerHandle m_autosaveTimer;
+
+	void Autosave();
+
+	bool m_bPreloading;
+
+	//Startup milestones in seconds since launch - in PIE launch is when the editor started
+	double m_initGameTime;
+	double m_beginPlayTime;
+	double m_preloadDoneTime;
+	double m_firstFrameTime;
+	int32 m_preloadAssetCount;
+
+	//Stream in the player pawn and the preload assets
+	void BeginPreload();
+	void OnPreloadComplete();
+
+	//Start the match once every spawn volume's pickup types are in as well
+	void FinishPreload();
+
 };
 
 
@@ -0,0 +1,218 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BatteryCollector.h"
+#include "BatteryCollectorStats.h"
+#include "RenderCore.h"
+
+DEFINE_STAT(STAT_CollectPickups);
+DEFINE_STAT(STAT_SpawnPickup);
+DEFINE_STAT(STAT_UpdatePower);
+DEFINE_STAT(STAT_HandleNewState);
+DEFINE_STAT(STAT_OnCharacterPowerChanged);
+DEFINE_STAT(STAT_PhysicsStep);
+DEFINE_STAT(STAT_HUDUpdate);
+DEFINE_STAT(STAT_GameModeTick);
+DEFINE_STAT(STAT_BotDecisions);
+
+DEFINE_STAT(STAT_LivePickups);
+DEFINE_STAT(STAT_PooledPickups);
+DEFINE_STAT(STAT_FrozenPickups);
+DEFINE_STAT(STAT_Collections);
+DEFINE_STAT(STAT_DeferredSpawns);
+
+uint64 FBatteryStatTotals::timerCycles[eBatteryTimer::eCount] = {};
+uint32 FBatteryStatTotals::timerCalls[eBatteryTimer::eCount] = {};
+int64 FBatteryStatTotals::counters[eBatteryCounter::eCount] = {};
+
+const TCHAR* FBatteryStatTotals::GetTimerName(eBatteryTimer::Type timer) {
+
+	switch(timer) {
+		case eBatteryTimer::eCollectPickups: return TEXT("CollectPickups");
+		case eBatteryTimer::eSpawnPickup: return TEXT("SpawnPickup");
+		case eBatteryTimer::eUpdatePower: return TEXT("UpdatePower");
+		case eBatteryTimer::eHandleNewState: return TEXT("HandleNewState");
+		case eBatteryTimer::eOnCharacterPowerChanged: return TEXT("OnCharacterPowerChanged");
+		case eBatteryTimer::ePhysicsStep: return TEXT("PhysicsStep");
+		case eBatteryTimer::eHUDUpdate: return TEXT("HUDUpdate");
+		case eBatteryTimer::eGameModeTick: return TEXT("GameModeTick");
+		case eBatteryTimer::eBotDecisions: return TEXT("BotDecisions");
+		default: return TEXT("Unknown");
+	}
+
+}
+
+const TCHAR* FBatteryStatTotals::GetCounterName(eBatteryCounter::Type counter) {
+
+	switch(counter) {
+		case eBatteryCounter::eLivePickups: return TEXT("LivePickups");
+		case eBatteryCounter::ePooledPickups: return TEXT("PooledPickups");
+		case eBatteryCounter::eFrozenPickups: return TEXT("FrozenPickups");
+		case eBatteryCounter::eCollections: return TEXT("Collections");
+		case eBatteryCounter::eDeferredSpawns: return TEXT("DeferredSpawns");
+		default: return TEXT("Unknown");
+	}
+
+}
+
+
+FBatteryPhysicsStepTimer::FBatteryPhysicsStepTimer() {
+
+	m_startCycles = 0;
+	m_lastStepMs = 0.0f;
+
+	m_startTick.owner = this;
+	m_startTick.bStart = true;
+	m_startTick.TickGroup = TG_StartPhysics;
+	m_startTick.bCanEverTick = true;
+
+	m_endTick.owner = this;
+	m_endTick.bStart = false;
+	m_endTick.TickGroup = TG_EndPhysics;
+	m_endTick.bCanEverTick = true;
+
+}
+
+void FBatteryPhysicsStepTimer::Register(UWorld* world) {
+
+	if(world == nullptr || m_startTick.IsTickFunctionRegistered()) {
+		return;
+	}
+
+	m_startTick.RegisterTickFunction(world->PersistentLevel);
+	m_endTick.RegisterTickFunction(world->PersistentLevel);
+
+	//Only stop the clock once the scene has finished
+	m_endTick.AddPrerequisite(world, world->EndPhysicsTickFunction);
+
+}
+
+void FBatteryPhysicsStepTimer::Unregister() {
+
+	m_startTick.UnRegisterTickFunction();
+	m_endTick.UnRegisterTickFunction();
+
+}
+
+void FBatteryPhysicsStepTimer::FStepTickFunction::ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) {
+
+	if(bStart) {
+		owner->m_startCycles = FPlatformTime::Cycles();
+		return;
+	}
+
+	const uint32 cycles = FPlatformTime::Cycles() - owner->m_startCycles;
+	owner->m_lastStepMs = FPlatformTime::ToMilliseconds(cycles);
+
+	SET_CYCLE_COUNTER(STAT_PhysicsStep, cycles);
+#if WITH_BATTERY_STATS
+	FBatteryStatTotals::timerCycles[eBatteryTimer::ePhysicsStep] += cycles;
+	FBatteryStatTotals::timerCalls[eBatteryTimer::ePhysicsStep]++;
+#endif
+
+}
+
+FString FBatteryPhysicsStepTimer::FStepTickFunction::DiagnosticMessage() {
+	return bStart ? TEXT("FBatteryPhysicsStepTimer start") : TEXT("FBatteryPhysicsStepTimer end");
+}
+
+
+FBatteryStatsCsv::FBatteryStatsCsv() {
+
+	m_archive = nullptr;
+	m_lastFrame = 0;
+	m_lastRealTime = 0.0;
+	m_lastCollections = 0;
+	m_lastDeferredSpawns = 0;
+
+}
+
+FBatteryStatsCsv::~FBatteryStatsCsv() {
+
+	Close();
+
+}
+
+bool FBatteryStatsCsv::Open() {
+
+	Close();
+
+	m_path = FPaths::ProfilingDir() / TEXT("BatteryStats") / FString::Printf(TEXT("BatteryStats-%s.csv"), *FDateTime::Now().ToString());
+	m_archive = IFileManager::Get().CreateFileWriter(*m_path);
+	if(m_archive == nullptr) {
+		UE_LOG(LogClass, Warning, TEXT("Can't write stats CSV %s"), *m_path);
+		return false;
+	}
+
+	FString header = TEXT("time,frames,frameMs,gameThreadMs");
+	for(int32 iTimer = 0; iTimer < eBatteryTimer::eCount; iTimer++) {
+		const TCHAR* const name = FBatteryStatTotals::GetTimerName((eBatteryTimer::Type)iTimer);
+		header += FString::Printf(TEXT(",%sMs,%sCalls"), name, name);
+	}
+	header += TEXT(",livePickups,pooledPickups,frozenPickups,collectionsPerFrame,deferredSpawnsPerFrame");
+	WriteLine(header);
+
+	StoreBaseline();
+
+	return true;
+
+}
+
+void FBatteryStatsCsv::Close() {
+
+	if(m_archive) {
+		m_archive->Close();
+		delete m_archive;
+		m_archive = nullptr;
+	}
+
+}
+
+void FBatteryStatsCsv::Sample(float gameTime) {
+
+	if(m_archive == nullptr) {
+		return;
+	}
+
+	const int32 frames = (int32)(GFrameCounter - m_lastFrame);
+	if(frames <= 0) {
+		return;
+	}
+
+	const double realSeconds = FPlatformTime::Seconds() - m_lastRealTime;
+
+	FString line = FString::Printf(TEXT("%.3f,%d,%.3f,%.3f"), gameTime, frames, realSeconds * 1000.0 / frames, FPlatformTime::ToMilliseconds(GGameThreadTime));
+	for(int32 iTimer = 0; iTimer < eBatteryTimer::eCount; iTimer++) {
+		const uint64 cycles = FBatteryStatTotals::timerCycles[iTimer] - m_lastCycles[iTimer];
+		const uint32 calls = FBatteryStatTotals::timerCalls[iTimer] - m_lastCalls[iTimer];
+		line += FString::Printf(TEXT(",%.4f,%u"), FPlatformTime::GetSecondsPerCycle() * cycles * 1000.0 / frames, calls);
+	}
+
+	const int64 collections = FBatteryStatTotals::counters[eBatteryCounter::eCollections] - m_lastCollections;
+	const int64 deferredSpawns = FBatteryStatTotals::counters[eBatteryCounter::eDeferredSpawns] - m_lastDeferredSpawns;
+	line += FString::Printf(TEXT(",%lld,%lld,%lld,%.3f,%.3f"), FBatteryStatTotals::counters[eBatteryCounter::eLivePickups], FBatteryStatTotals::counters[eBatteryCounter::ePooledPickups],
+		FBatteryStatTotals::counters[eBatteryCounter::eFrozenPickups], (double)collections / frames, (double)deferredSpawns / frames);
+	WriteLine(line);
+
+	StoreBaseline();
+
+}
+
+void FBatteryStatsCsv::WriteLine(const FString& line) {
+
+	FTCHARToUTF8 converted(*(line + LINE_TERMINATOR));
+	m_archive->Serialize((void*)converted.Get(), converted.Length());
+	//Headless runs are often killed rather than quit, so don't sit on rows
+	m_archive->Flush();
+
+}
+
+void FBatteryStatsCsv::StoreBaseline() {
+
+	m_lastFrame = GFrameCounter;
+	m_lastRealTime = FPlatformTime::Seconds();
+	FMemory::Memcpy(m_lastCycles, FBatteryStatTotals::timerCycles, sizeof(m_lastCycles));
+	FMemory::Memcpy(m_lastCalls, FBatteryStatTotals::timerCalls, sizeof(m_lastCalls));
+	m_lastCollections = FBatteryStatTotals::counters[eBatteryCounter::eCollections];
+	m_lastDeferredSpawns = FBatteryStatTotals::counters[eBatteryCounter::eDeferredSpawns];
+
+}
@@ -0,0 +1,181 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+/**
+ * Gameplay stats. Everything here shows up under "stat BatteryCollector" in game, and is also kept in a few plain
+ * totals so it can be sampled into a CSV without a stats capture (see FBatteryStatsCsv).
+ */
+
+DECLARE_STATS_GROUP(TEXT("BatteryCollector"), STATGROUP_BatteryCollector, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("CollectPickups"), STAT_CollectPickups, STATGROUP_BatteryCollector, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("SpawnPickup"), STAT_SpawnPickup, STATGROUP_BatteryCollector, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("UpdatePower"), STAT_UpdatePower, STATGROUP_BatteryCollector, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("HandleNewState"), STAT_HandleNewState, STATGROUP_BatteryCollector, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("OnCharacterPowerChanged"), STAT_OnCharacterPowerChanged, STATGROUP_BatteryCollector, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Physics Step"), STAT_PhysicsStep, STATGROUP_BatteryCollector, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("HUD Update"), STAT_HUDUpdate, STATGROUP_BatteryCollector, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Game Mode Tick"), STAT_GameModeTick, STATGROUP_BatteryCollector, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Bot Decisions"), STAT_BotDecisions, STATGROUP_BatteryCollector, );
+
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Live Pickups"), STAT_LivePickups, STATGROUP_BatteryCollector, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Pooled Pickups In Use"), STAT_PooledPickups, STATGROUP_BatteryCollector, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Frozen Pickups"), STAT_FrozenPickups, STATGROUP_BatteryCollector, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Collections"), STAT_Collections, STATGROUP_BatteryCollector, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Deferred Spawns"), STAT_DeferredSpawns, STATGROUP_BatteryCollector, );
+
+//The CSV totals cost a couple of cycle reads per scope, they are left out of shipping builds
+#define WITH_BATTERY_STATS !UE_BUILD_SHIPPING
+
+namespace eBatteryTimer {
+	enum Type {
+		eCollectPickups,
+		eSpawnPickup,
+		eUpdatePower,
+		eHandleNewState,
+		eOnCharacterPowerChanged,
+		//Not a scope - from the start of the physics tick group to the end of it, see FBatteryPhysicsStepTimer
+		ePhysicsStep,
+		eHUDUpdate,
+		eGameModeTick,
+		eBotDecisions,
+		eCount
+	};
+}
+
+namespace eBatteryCounter {
+	enum Type {
+		//Current values
+		eLivePickups,
+		ePooledPickups,
+		eFrozenPickups,
+		//Running totals
+		eCollections,
+		eDeferredSpawns,
+		eCount
+	};
+}
+
+//Running totals read by the CSV sampler. Gameplay code is game thread only, so these are plain integers
+struct BATTERYCOLLECTOR_API FBatteryStatTotals {
+	static uint64 timerCycles[eBatteryTimer::eCount];
+	static uint32 timerCalls[eBatteryTimer::eCount];
+	static int64 counters[eBatteryCounter::eCount];
+
+	static const TCHAR* GetTimerName(eBatteryTimer::Type timer);
+	static const TCHAR* GetCounterName(eBatteryCounter::Type counter);
+};
+
+#if WITH_BATTERY_STATS
+
+//Adds the cycles spent in its scope to a timer total
+class FBatteryScopeTimer {
+
+public:
+	FORCEINLINE explicit FBatteryScopeTimer(eBatteryTimer::Type timer) : m_timer(timer), m_startCycles(FPlatformTime::Cycles()) {}
+
+	FORCEINLINE ~FBatteryScopeTimer() {
+		FBatteryStatTotals::timerCycles[m_timer] += FPlatformTime::Cycles() - m_startCycles;
+		FBatteryStatTotals::timerCalls[m_timer]++;
+	}
+
+private:
+	eBatteryTimer::Type m_timer;
+	uint32 m_startCycles;
+
+};
+
+#define BATTERY_SCOPE_CYCLE_COUNTER(Name) \
+	SCOPE_CYCLE_COUNTER(STAT_##Name); \
+	FBatteryScopeTimer BatteryScopeTimer_##Name(eBatteryTimer::e##Name)
+
+#define BATTERY_INC_COUNTER_BY(Name, Amount) \
+	do { INC_DWORD_STAT_BY(STAT_##Name, Amount); FBatteryStatTotals::counters[eBatteryCounter::e##Name] += (Amount); } while(0)
+
+#define BATTERY_DEC_COUNTER_BY(Name, Amount) \
+	do { DEC_DWORD_STAT_BY(STAT_##Name, Amount); FBatteryStatTotals::counters[eBatteryCounter::e##Name] -= (Amount); } while(0)
+
+#else
+
+#define BATTERY_SCOPE_CYCLE_COUNTER(Name) SCOPE_CYCLE_COUNTER(STAT_##Name)
+#define BATTERY_INC_COUNTER_BY(Name, Amount) INC_DWORD_STAT_BY(STAT_##Name, Amount)
+#define BATTERY_DEC_COUNTER_BY(Name, Amount) DEC_DWORD_STAT_BY(STAT_##Name, Amount)
+
+#endif
+
+/**
+ * Times the physics step each frame: one tick function runs as the StartPhysics tick group starts and one once the
+ * EndPhysics tick function has waited for the scene. Game thread work in the DuringPhysics group overlaps the step,
+ * so this is the wall time of the physics window rather than the solver time alone.
+ */
+class BATTERYCOLLECTOR_API FBatteryPhysicsStepTimer {
+
+public:
+	FBatteryPhysicsStepTimer();
+
+	void Register(UWorld* world);
+	void Unregister();
+
+	//Length of the last physics window in milliseconds
+	FORCEINLINE float GetLastStepMs() const { return m_lastStepMs; }
+
+private:
+	struct FStepTickFunction : public FTickFunction {
+		FBatteryPhysicsStepTimer* owner;
+		bool bStart;
+
+		virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override;
+		virtual FString DiagnosticMessage() override;
+	};
+
+	FStepTickFunction m_startTick;
+	FStepTickFunction m_endTick;
+
+	uint32 m_startCycles;
+	float m_lastStepMs;
+
+};
+
+/**
+ * Samples the gameplay stat totals into Saved/Profiling/BatteryStats/BatteryStats-<timestamp>.csv.
+ *
+ * Each row covers the frames since the previous one: average milliseconds per frame spent in every timer, the live,
+ * pooled and frozen pickup counts at the time of the sample, and collections and spawns carried over per frame. Samples are taken on a game time
+ * timer, so a fixed timestep run gives the same rows on every machine.
+ */
+class BATTERYCOLLECTOR_API FBatteryStatsCsv {
+
+public:
+	FBatteryStatsCsv();
+	~FBatteryStatsCsv();
+
+	//Open a new file, rows start from now. Returns false if the file can't be written
+	bool Open();
+
+	void Close();
+
+	FORCEINLINE bool IsOpen() const { return m_archive != nullptr; }
+
+	//Write a row for everything since the last sample
+	void Sample(float gameTime);
+
+	FORCEINLINE const FString& GetPath() const { return m_path; }
+
+private:
+	void WriteLine(const FString& line);
+
+	//Remember the totals the next row is measured from
+	void StoreBaseline();
+
+	FArchive* m_archive;
+	FString m_path;
+
+	uint64 m_lastFrame;
+	double m_lastRealTime;
+	uint64 m_lastCycles[eBatteryTimer::eCount];
+	uint32 m_lastCalls[eBatteryTimer::eCount];
+	int64 m_lastCollections;
+	int64 m_lastDeferredSpawns;
+
+};
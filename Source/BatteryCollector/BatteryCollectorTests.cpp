@@ -0,0 +1,616 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BatteryCollector.h"
+#include "BatteryCollectorCharacter.h"
+#include "BatteryCollectorGameMode.h"
+#include "BatteryPickup.h"
+#include "SpawnVolume.h"
+#include "PickupPool.h"
+#include "EngineUtils.h"
+#include "Serialization/ArchiveCountMem.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+/**
+ * Automation tests for the gameplay code. They run in the game world that is already up, against the real game mode
+ * and level, so start the game on the collection level and queue them, e.g. headless on Linux:
+ *
+ *   BatteryCollector CollectionLevel -game -nullrhi -nosound -unattended
+ *       -ExecCmds="Automation RunTests BatteryCollector" -TestExit="Automation Test Queue Empty"
+ *
+ * BatteryCollector.Functional covers collecting, power, play state, checkpoints and spawning. BatteryCollector.Performance fails
+ * when a measurement is over its budget; -BatteryPerfBudgetScale=N loosens every budget on slow machines. Each
+ * measurement is also appended to Saved/Profiling/BatteryTests/BatteryPerf.csv, one row per metric per run, so
+ * builds can be compared. Tests that change the match put it back the way they found it.
+ */
+
+namespace {
+	//Test actors go far from anything in the level, nothing there collects them or is collected
+	const FVector TestOrigin(100000.0f, 100000.0f, 20000.0f);
+
+	//Budgets, in the units the metrics are recorded in
+	const double SpawnBudgetMs = 0.25;
+	const double PooledSpawnBudgetMs = 0.05;
+	const double CollectBudgetMs = 1.0;
+	const double GameModeTickBudgetMs = 0.1;
+	const double BytesPerPickupBudget = 32.0 * 1024.0;
+
+	//The running game world, with the game mode when it is ours
+	UWorld* GetTestWorld(FAutomationTestBase& test, ABatteryCollectorGameMode*& outGameMode) {
+
+		for(const FWorldContext& context : GEngine->GetWorldContexts()) {
+			UWorld* const world = context.World();
+			if(world && (context.WorldType == EWorldType::Game || context.WorldType == EWorldType::PIE)) {
+				outGameMode = world->GetAuthGameMode<ABatteryCollectorGameMode>();
+				if(outGameMode == nullptr) {
+					test.AddError(TEXT("The game world has no BatteryCollector game mode"));
+				}
+				return outGameMode ? world : nullptr;
+			}
+		}
+
+		test.AddError(TEXT("No game world, run the tests with the game running (-game)"));
+		return nullptr;
+
+	}
+
+	ABatteryCollectorCharacter* SpawnTestCharacter(UWorld* world) {
+
+		FActorSpawnParameters spawnParams;
+		spawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		return world->SpawnActor<ABatteryCollectorCharacter>(ABatteryCollectorCharacter::StaticClass(), TestOrigin, FRotator::ZeroRotator, spawnParams);
+
+	}
+
+	//A battery with a mesh given before it begins play, so it registers with the right bounds
+	ABatteryPickup* SpawnTestBattery(UWorld* world, const FVector& location) {
+
+		static UStaticMesh* const testMesh = LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Sphere.Sphere"));
+
+		const FTransform spawnTransform(FRotator::ZeroRotator, location, FVector(0.25f));
+		ABatteryPickup* const battery = world->SpawnActorDeferred<ABatteryPickup>(ABatteryPickup::StaticClass(), spawnTransform, nullptr, nullptr, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+		if(battery) {
+			battery->GetMesh()->SetStaticMesh(testMesh);
+			battery->FinishSpawning(spawnTransform);
+		}
+		return battery;
+
+	}
+
+	//A volume spawning plain batteries. whatToSpawn is only editable, so it is set through its property
+	ASpawnVolume* SpawnTestVolume(UWorld* world) {
+
+		const FTransform spawnTransform(TestOrigin);
+		ASpawnVolume* const volume = world->SpawnActorDeferred<ASpawnVolume>(ASpawnVolume::StaticClass(), spawnTransform, nullptr, nullptr, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+		if(volume) {
+			UClassProperty* const whatToSpawn = FindField<UClassProperty>(ASpawnVolume::StaticClass(), TEXT("whatToSpawn"));
+			if(whatToSpawn) {
+				whatToSpawn->SetObjectPropertyValue_InContainer(volume, ABatteryPickup::StaticClass());
+			}
+			volume->FinishSpawning(spawnTransform);
+		}
+		return volume;
+
+	}
+
+	//Memory an object accounts for, the way "obj list" counts it: the object, what its properties allocate and any
+	//resources it owns outside them
+	SIZE_T GetObjectBytes(UObject* object) {
+
+		FArchiveCountMem countMem(object);
+		return object->GetClass()->GetStructureSize() + countMem.GetMax() + object->GetResourceSizeBytes(EResourceSizeMode::Exclusive);
+
+	}
+
+	//Destroy a test volume along with everything its pools spawned
+	void DestroyTestVolume(ASpawnVolume* volume) {
+
+		volume->DeactivatePickups();
+		for(TActorIterator<APickup> iterator(volume->GetWorld()); iterator; ++iterator) {
+			if(iterator->GetOwner() == volume) {
+				iterator->Destroy();
+			}
+		}
+		volume->Destroy();
+
+	}
+
+	//Check a measurement against its budget and append it to the results file
+	void RecordPerf(FAutomationTestBase& test, const TCHAR* metric, double value, double budget, const TCHAR* unit) {
+
+		float budgetScale = 1.0f;
+		FParse::Value(FCommandLine::Get(), TEXT("BatteryPerfBudgetScale="), budgetScale);
+		budget *= FMath::Max(budgetScale, 0.0f);
+
+		const bool bPassed = value <= budget;
+		if(bPassed) {
+			test.AddLogItem(FString::Printf(TEXT("%s: %.4f %s (budget %.4f)"), metric, value, unit, budget));
+		} else {
+			test.AddError(FString::Printf(TEXT("%s: %.4f %s is over the budget of %.4f"), metric, value, unit, budget));
+		}
+
+		//Rows from one run share its start time
+		static const FString runTime = FDateTime::Now().ToString();
+		const FString path = FPaths::ProfilingDir() / TEXT("BatteryTests") / TEXT("BatteryPerf.csv");
+
+		FString lines;
+		if(!IFileManager::Get().FileExists(*path)) {
+			lines = TEXT("run,buildDate,configuration,changelist,metric,value,unit,budget,passed\n");
+		}
+		lines += FString::Printf(TEXT("%s,%s,%s,%u,%s,%.6f,%s,%.6f,%d\n"), *runTime, *FApp::GetBuildDate().Replace(TEXT(","), TEXT(" ")),
+			EBuildConfigurations::ToString(FApp::GetBuildConfiguration()), FEngineVersion::Current().GetChangelist(), metric, value, unit, budget, bPassed ? 1 : 0);
+		FFileHelper::SaveStringToFile(lines, *path, FFileHelper::EEncodingOptions::ForceAnsi, &IFileManager::Get(), FILEWRITE_Append);
+
+	}
+
+	//Average game mode tick over the next frames, read from the stat totals so the frames are real ones
+	class FMeasureGameModeTickCommand : public IAutomationLatentCommand {
+
+	public:
+		FMeasureGameModeTickCommand(FAutomationTestBase* test, int32 frames) : m_test(test), m_frames(frames), m_startFrame(0), m_startCycles(0), m_startCalls(0) {}
+
+		virtual bool Update() override {
+
+			if(m_startFrame == 0) {
+				m_startFrame = GFrameCounter;
+				m_startCycles = FBatteryStatTotals::timerCycles[eBatteryTimer::eGameModeTick];
+				m_startCalls = FBatteryStatTotals::timerCalls[eBatteryTimer::eGameModeTick];
+				return false;
+			}
+			if(GFrameCounter - m_startFrame < (uint64)m_frames) {
+				return false;
+			}
+
+			const uint32 calls = FBatteryStatTotals::timerCalls[eBatteryTimer::eGameModeTick] - m_startCalls;
+			if(calls == 0) {
+				m_test->AddError(TEXT("The game mode didn't tick"));
+				return true;
+			}
+			const double tickMs = FPlatformTime::GetSecondsPerCycle() * (FBatteryStatTotals::timerCycles[eBatteryTimer::eGameModeTick] - m_startCycles) * 1000.0 / calls;
+			RecordPerf(*m_test, TEXT("GameModeTick.msPerTick"), tickMs, GameModeTickBudgetMs, TEXT("ms"));
+			return true;
+
+		}
+
+	private:
+		FAutomationTestBase* m_test;
+		int32 m_frames;
+		uint64 m_startFrame;
+		uint64 m_startCycles;
+		uint32 m_startCalls;
+
+	};
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBatteryUpdatePowerTest, "BatteryCollector.Functional.UpdatePower", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FBatteryUpdatePowerTest::RunTest(const FString& Parameters) {
+
+	ABatteryCollectorGameMode* gameMode = nullptr;
+	UWorld* const world = GetTestWorld(*this, gameMode);
+	ABatteryCollectorCharacter* const character = world ? SpawnTestCharacter(world) : nullptr;
+	if(character == nullptr) {
+		return false;
+	}
+
+	int32 broadcasts = 0;
+	const FDelegateHandle powerHandle = character->OnPowerChanged.AddLambda([&broadcasts](ABatteryCollectorCharacter*) { broadcasts++; });
+
+	const float startPower = character->GetCurrentPower();
+	TestEqual(TEXT("Starts at its initial power"), startPower, character->GetInitialPower());
+
+	character->UpdatePower(250.0f, ePowerChangeReason::ePickup);
+	TestEqual(TEXT("Power after a gain"), character->GetCurrentPower(), startPower + 250.0f, 0.01f);
+
+	character->UpdatePower(-100.0f);
+	TestEqual(TEXT("Power after a loss"), character->GetCurrentPower(), startPower + 150.0f, 0.01f);
+	TestEqual(TEXT("Every change is broadcast"), broadcasts, 2);
+
+	//Decay is worked out from the rate rather than applied every frame
+	character->SetPowerDecayRate(10.0f);
+	TestEqual(TEXT("Decay rate"), character->GetPowerDecayRate(), 10.0f);
+	TestEqual(TEXT("Time until 50 power has decayed"), character->GetTimeUntilPower(character->GetCurrentPower() - 50.0f), 5.0f, 0.01f);
+	character->SetPowerDecayRate(0.0f);
+
+	character->OnPowerChanged.Remove(powerHandle);
+	character->Destroy();
+	return true;
+
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBatteryCollectPickupsTest, "BatteryCollector.Functional.CollectPickups", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FBatteryCollectPickupsTest::RunTest(const FString& Parameters) {
+
+	ABatteryCollectorGameMode* gameMode = nullptr;
+	UWorld* const world = GetTestWorld(*this, gameMode);
+	ABatteryCollectorCharacter* const character = world ? SpawnTestCharacter(world) : nullptr;
+	if(character == nullptr) {
+		return false;
+	}
+
+	const float radius = character->GetCollectionSphere()->GetScaledSphereRadius();
+	const FVector center = character->GetCollectionSphere()->GetComponentLocation();
+
+	//One to collect, one already collected and one out of reach
+	TWeakObjectPtr<ABatteryPickup> inRange = SpawnTestBattery(world, center);
+	TWeakObjectPtr<ABatteryPickup> inactive = SpawnTestBattery(world, center);
+	TWeakObjectPtr<ABatteryPickup> outOfRange = SpawnTestBattery(world, center + FVector(radius * 3.0f, 0.0f, 0.0f));
+	if(!inRange.IsValid() || !inactive.IsValid() || !outOfRange.IsValid()) {
+		AddError(TEXT("Can't spawn the test batteries"));
+		return false;
+	}
+	inactive->SetActive(false);
+
+	const float expectedPower = character->GetCurrentPower() + inRange->GetPower();
+	const int32 collectedBefore = gameMode->GetPickupsCollected();
+
+	character->CollectPickups();
+
+	TestEqual(TEXT("Power gained from the battery in range"), character->GetCurrentPower(), expectedPower, 0.01f);
+	TestEqual(TEXT("Collections counted"), gameMode->GetPickupsCollected(), collectedBefore + 1);
+	TestTrue(TEXT("Battery in range is collected"), !inRange.IsValid() || inRange->IsPendingKill() || !inRange->IsActive());
+	TestTrue(TEXT("Inactive battery is left alone"), inactive.IsValid() && !inactive->IsPendingKill());
+	TestTrue(TEXT("Battery out of range is still active"), outOfRange.IsValid() && outOfRange->IsActive());
+
+	for(TWeakObjectPtr<ABatteryPickup> battery : { inRange, inactive, outOfRange }) {
+		if(battery.IsValid()) {
+			battery->Destroy();
+		}
+	}
+	character->Destroy();
+	return true;
+
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBatteryPlayStateTest, "BatteryCollector.Functional.PlayState", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FBatteryPlayStateTest::RunTest(const FString& Parameters) {
+
+	ABatteryCollectorGameMode* gameMode = nullptr;
+	UWorld* const world = GetTestWorld(*this, gameMode);
+	if(world == nullptr) {
+		return false;
+	}
+
+	//Game over is only tested from a match that is being played, which is what it is put back to
+	if(gameMode->GetCurrentState() != eBatteryPlayState::ePlaying) {
+		AddWarning(TEXT("The match isn't being played, skipping"));
+		return true;
+	}
+
+	//Game over stops every player's decay, playing again doesn't restart it - that is the players' own start
+	TArray<ABatteryCollectorCharacter*> players;
+	TArray<float> decayRates;
+	for(FConstPlayerControllerIterator iterator = world->GetPlayerControllerIterator(); iterator; ++iterator) {
+		ABatteryCollectorCharacter* const character = iterator->Get() ? Cast<ABatteryCollectorCharacter>(iterator->Get()->GetPawn()) : nullptr;
+		if(character) {
+			players.Add(character);
+			decayRates.Add(character->GetPowerDecayRate());
+		}
+	}
+
+	TArray<eBatteryPlayState> broadcastStates;
+	const FDelegateHandle stateHandle = gameMode->OnPlayStateChanged.AddLambda([&broadcastStates](eBatteryPlayState state) { broadcastStates.Add(state); });
+
+	ABatteryPickup* const battery = SpawnTestBattery(world, TestOrigin);
+	TestTrue(TEXT("Pickups are active while playing"), battery && battery->IsActive());
+
+	//Game over stops spawning and the players' power
+	gameMode->SetCurrentState(eBatteryPlayState::eGameOver);
+	TestEqual(TEXT("State after game over"), (int32)gameMode->GetCurrentState(), (int32)eBatteryPlayState::eGameOver);
+	TestFalse(TEXT("Spawning stops on game over"), gameMode->IsActorTickEnabled());
+	for(ABatteryCollectorCharacter* const character : players) {
+		TestEqual(TEXT("Power stops decaying on game over"), character->GetPowerDecayRate(), 0.0f);
+	}
+
+	//And playing again starts spawning back up
+	gameMode->SetCurrentState(eBatteryPlayState::ePlaying);
+	TestEqual(TEXT("State after playing again"), (int32)gameMode->GetCurrentState(), (int32)eBatteryPlayState::ePlaying);
+	TestTrue(TEXT("Spawning starts again"), gameMode->IsActorTickEnabled());
+
+	TestEqual(TEXT("State changes broadcast"), broadcastStates.Num(), 2);
+	if(broadcastStates.Num() == 2) {
+		TestEqual(TEXT("First broadcast"), (int32)broadcastStates[0], (int32)eBatteryPlayState::eGameOver);
+		TestEqual(TEXT("Second broadcast"), (int32)broadcastStates[1], (int32)eBatteryPlayState::ePlaying);
+	}
+
+	//Put the players' decay back and let the game mode schedule their run-out times again
+	for(int32 iPlayer = 0; iPlayer < players.Num(); iPlayer++) {
+		players[iPlayer]->SetPowerDecayRate(decayRates[iPlayer]);
+		gameMode->OnCharacterPowerChanged(players[iPlayer]);
+	}
+
+	gameMode->OnPlayStateChanged.Remove(stateHandle);
+	if(battery) {
+		battery->Destroy();
+	}
+	return true;
+
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBatteryCheckpointRestoreTest, "BatteryCollector.Functional.CheckpointRestore", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FBatteryCheckpointRestoreTest::RunTest(const FString& Parameters) {
+
+	ABatteryCollectorGameMode* gameMode = nullptr;
+	UWorld* const world = GetTestWorld(*this, gameMode);
+	if(world == nullptr) {
+		return false;
+	}
+
+	//Saved while playing, so restoring it puts the match back the way it was
+	if(gameMode->GetCurrentState() != eBatteryPlayState::ePlaying || gameMode->IsRestoringCheckpoint()) {
+		AddWarning(TEXT("The match isn't being played, skipping"));
+		return true;
+	}
+
+	const FString checkpointName(TEXT("AutomationTest"));
+	FCheckpointData saved;
+	gameMode->CaptureCheckpoint(saved);
+	if(FBatteryCheckpoint::Save(checkpointName, saved) == 0) {
+		AddError(TEXT("Can't save the test checkpoint"));
+		return false;
+	}
+
+	//Restoring out of a finished match has to bring back the spawn phases and the players' power
+	gameMode->SetCurrentState(eBatteryPlayState::eGameOver);
+	gameMode->LoadCheckpoint(checkpointName);
+
+	//World time stands still while the test runs, so every frame of the restore happens at the same moment
+	for(int32 iFrame = 0; iFrame < 10000 && gameMode->IsRestoringCheckpoint(); iFrame++) {
+		gameMode->Tick(0.0f);
+	}
+	IFileManager::Get().Delete(*FBatteryCheckpoint::GetCheckpointPath(checkpointName));
+
+	TestFalse(TEXT("Restore finished"), gameMode->IsRestoringCheckpoint());
+	TestEqual(TEXT("State after the restore"), (int32)gameMode->GetCurrentState(), (int32)eBatteryPlayState::ePlaying);
+
+	const float now = world->GetTimeSeconds();
+	for(TActorIterator<ASpawnVolume> iterator(world); iterator; ++iterator) {
+		const int32 iVolume = saved.volumeNames.IndexOfByKey(FCrc::StrCrc32(*iterator->GetName()));
+		if(iVolume == INDEX_NONE || saved.spawnPhases[iVolume] < 0.0f || iterator->GetSignificance() == eSpawnSignificance::ePaused) {
+			continue;
+		}
+
+		float dueTime = 0.0f;
+		TestTrue(TEXT("Restored volume has a spawn due"), gameMode->GetSpawnScheduler().FindDueTime(*iterator, dueTime));
+		TestEqual(TEXT("Restored volume keeps its spawn phase"), dueTime, now + saved.spawnPhases[iVolume], 0.01f);
+	}
+
+	int32 iPlayer = 0;
+	for(FConstPlayerControllerIterator iterator = world->GetPlayerControllerIterator(); iterator && iPlayer < saved.playerPower.Num(); ++iterator, ++iPlayer) {
+		ABatteryCollectorCharacter* const character = iterator->Get() ? Cast<ABatteryCollectorCharacter>(iterator->Get()->GetPawn()) : nullptr;
+		if(character) {
+			TestEqual(TEXT("Restored player keeps their power"), character->GetCurrentPower(), saved.playerPower[iPlayer], 0.01f);
+			TestTrue(TEXT("Restored player's power decays again"), character->GetPowerDecayRate() > 0.0f);
+		}
+	}
+
+	return true;
+
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBatterySpawnPickupTest, "BatteryCollector.Functional.SpawnPickup", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FBatterySpawnPickupTest::RunTest(const FString& Parameters) {
+
+	ABatteryCollectorGameMode* gameMode = nullptr;
+	UWorld* const world = GetTestWorld(*this, gameMode);
+	ASpawnVolume* const volume = world ? SpawnTestVolume(world) : nullptr;
+	if(volume == nullptr || volume->GetPoolAt(0) == nullptr) {
+		AddError(TEXT("Can't spawn a test volume"));
+		return false;
+	}
+
+	const int32 inUseBefore = volume->GetPoolStats().inUse;
+	const int32 spawnedBefore = gameMode->GetPickupsSpawned();
+
+	TestTrue(TEXT("SpawnPickup succeeds"), volume->SpawnPickup());
+	TestEqual(TEXT("Pickups in use"), volume->GetPoolStats().inUse, inUseBefore + 1);
+	TestEqual(TEXT("Spawns counted"), gameMode->GetPickupsSpawned(), spawnedBefore + 1);
+
+	const TArray<APickup*>& inUse = volume->GetPoolAt(0)->GetPickupsInUse();
+	APickup* const pickup = inUse.Num() > 0 ? inUse.Last() : nullptr;
+	TestNotNull(TEXT("Spawned pickup"), pickup);
+	if(pickup) {
+		TestTrue(TEXT("Spawned pickup is a battery"), pickup->IsA<ABatteryPickup>());
+		TestTrue(TEXT("Spawned pickup is active"), pickup->IsActive());
+		TestTrue(TEXT("Spawned inside the volume"), volume->GetSpawnBounds().ExpandBy(1.0f).IsInside(pickup->GetActorLocation()));
+	}
+
+	DestroyTestVolume(volume);
+	return true;
+
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBatterySpawnThroughputTest, "BatteryCollector.Performance.SpawnThroughput", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FBatterySpawnThroughputTest::RunTest(const FString& Parameters) {
+
+	ABatteryCollectorGameMode* gameMode = nullptr;
+	UWorld* const world = GetTestWorld(*this, gameMode);
+	ASpawnVolume* const volume = world ? SpawnTestVolume(world) : nullptr;
+	if(volume == nullptr) {
+		AddError(TEXT("Can't spawn a test volume"));
+		return false;
+	}
+
+	const int32 spawnCount = 500;
+
+	//First pass grows the pool, so most of these spawn actors
+	double startTime = FPlatformTime::Seconds();
+	for(int32 iSpawn = 0; iSpawn < spawnCount; iSpawn++) {
+		volume->SpawnPickup();
+	}
+	const double spawnMs = (FPlatformTime::Seconds() - startTime) * 1000.0 / spawnCount;
+
+	//Second pass only reuses them
+	volume->DeactivatePickups();
+	startTime = FPlatformTime::Seconds();
+	for(int32 iSpawn = 0; iSpawn < spawnCount; iSpawn++) {
+		volume->SpawnPickup();
+	}
+	const double pooledSpawnMs = (FPlatformTime::Seconds() - startTime) * 1000.0 / spawnCount;
+
+	TestEqual(TEXT("Every spawn succeeded"), volume->GetPoolStats().inUse, spawnCount);
+	RecordPerf(*this, TEXT("SpawnThroughput.msPerSpawn"), spawnMs, SpawnBudgetMs, TEXT("ms"));
+	RecordPerf(*this, TEXT("SpawnThroughput.msPerPooledSpawn"), pooledSpawnMs, PooledSpawnBudgetMs, TEXT("ms"));
+
+	DestroyTestVolume(volume);
+	return true;
+
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBatteryCollectionQueryTest, "BatteryCollector.Performance.CollectionQuery", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FBatteryCollectionQueryTest::RunTest(const FString& Parameters) {
+
+	ABatteryCollectorGameMode* gameMode = nullptr;
+	UWorld* const world = GetTestWorld(*this, gameMode);
+	if(world == nullptr) {
+		return false;
+	}
+
+	ABatteryCollectorCharacter* const character = SpawnTestCharacter(world);
+	if(character == nullptr) {
+		return false;
+	}
+
+	//CollectPickups takes what the collection sphere's overlaps put in reach, so it should cost the same however many
+	//batteries there are. The character is moved across a flat grid of them and collects at spots far enough apart
+	//that every collect finds a full sphere of batteries
+	const float radius = character->GetCollectionSphere()->GetScaledSphereRadius();
+	const float spacing = 60.0f;
+	const float stride = 2.0f * (radius + spacing);
+
+	const int32 pickupCounts[] = { 1000, 10000 };
+
+	for(int32 iCount = 0; iCount < ARRAY_COUNT(pickupCounts); iCount++) {
+
+		const int32 pickupCount = pickupCounts[iCount];
+		const int32 side = FMath::CeilToInt(FMath::Sqrt((float)pickupCount));
+		TArray<ABatteryPickup*> batteries;
+		batteries.Reserve(pickupCount);
+		for(int32 iPickup = 0; iPickup < pickupCount; iPickup++) {
+			const FVector offset((iPickup % side - side / 2) * spacing, (iPickup / side - side / 2) * spacing, 0.0f);
+			batteries.Add(SpawnTestBattery(world, TestOrigin + offset));
+		}
+
+		//Moving the character is left out of the time, only the collects are measured
+		const float halfExtent = (side / 2) * spacing - radius;
+		const int32 collectedBefore = gameMode->GetPickupsCollected();
+		double collectSeconds = 0.0;
+		int32 collects = 0;
+		for(float y = -halfExtent; y <= halfExtent; y += stride) {
+			for(float x = -halfExtent; x <= halfExtent; x += stride) {
+				character->SetActorLocation(TestOrigin + FVector(x, y, 0.0f));
+
+				const double startTime = FPlatformTime::Seconds();
+				character->CollectPickups();
+				collectSeconds += FPlatformTime::Seconds() - startTime;
+				collects++;
+			}
+		}
+		const double collectMs = collects > 0 ? collectSeconds * 1000.0 / collects : 0.0;
+
+		TestTrue(TEXT("Collects find the batteries around the character"), gameMode->GetPickupsCollected() > collectedBefore);
+		RecordPerf(*this, *FString::Printf(TEXT("CollectionQuery.msPerCollect%d"), pickupCount), collectMs, CollectBudgetMs, TEXT("ms"));
+
+		//Collected batteries have already destroyed themselves
+		for(ABatteryPickup* const battery : batteries) {
+			if(battery && !battery->IsPendingKill()) {
+				battery->Destroy();
+			}
+		}
+	}
+
+	character->Destroy();
+	return true;
+
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBatteryGameModeTickTest, "BatteryCollector.Performance.GameModeTick", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FBatteryGameModeTickTest::RunTest(const FString& Parameters) {
+
+	ABatteryCollectorGameMode* gameMode = nullptr;
+	UWorld* const world = GetTestWorld(*this, gameMode);
+	if(world == nullptr) {
+		return false;
+	}
+
+	//The game mode only ticks while the match is being played, starting it again here would leave it half restarted
+	if(gameMode->GetCurrentState() != eBatteryPlayState::ePlaying) {
+		AddWarning(TEXT("The match isn't being played, skipping"));
+		return true;
+	}
+
+	ADD_LATENT_AUTOMATION_COMMAND(FMeasureGameModeTickCommand(this, 300));
+	return true;
+
+}
+
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FBatteryPickupMemoryTest, "BatteryCollector.Performance.PickupMemory", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FBatteryPickupMemoryTest::RunTest(const FString& Parameters) {
+
+	ABatteryCollectorGameMode* gameMode = nullptr;
+	UWorld* const world = GetTestWorld(*this, gameMode);
+	if(world == nullptr) {
+		return false;
+	}
+
+	const int32 pickupCount = 200;
+	const float spacing = 60.0f;
+	const int32 side = FMath::CeilToInt(FMath::Sqrt((float)pickupCount));
+
+	TArray<ABatteryPickup*> batteries;
+	batteries.Reserve(pickupCount);
+	for(int32 iPickup = 0; iPickup < pickupCount; iPickup++) {
+		const FVector offset((iPickup % side) * spacing, (iPickup / side) * spacing, 0.0f);
+		batteries.Add(SpawnTestBattery(world, TestOrigin + offset));
+	}
+
+	//Counted per object rather than from the process's memory, which moves with everything else the game is doing
+	SIZE_T totalBytes = 0;
+	int32 counted = 0;
+	for(ABatteryPickup* const battery : batteries) {
+		if(battery == nullptr) {
+			continue;
+		}
+
+		totalBytes += GetObjectBytes(battery);
+		TInlineComponentArray<UActorComponent*> components;
+		battery->GetComponents(components);
+		for(UActorComponent* const component : components) {
+			totalBytes += GetObjectBytes(component);
+		}
+		counted++;
+	}
+
+	TestEqual(TEXT("Every battery spawned"), counted, pickupCount);
+	const double bytesPerPickup = counted > 0 ? (double)totalBytes / counted : 0.0;
+	TestTrue(TEXT("Batteries take up memory"), bytesPerPickup > 0.0);
+	RecordPerf(*this, TEXT("PickupMemory.bytesPerPickup"), bytesPerPickup, BytesPerPickupBudget, TEXT("bytes"));
+
+	for(ABatteryPickup* const battery : batteries) {
+		if(battery) {
+			battery->Destroy();
+		}
+	}
+	return true;
+
+}
+
+#endif
@@ -0,0 +1,74 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BatteryCollector.h"
+#include "BatteryEventDecodeCommandlet.h"
+#include "BatteryEventLog.h"
+
+UBatteryEventDecodeCommandlet::UBatteryEventDecodeCommandlet() {
+
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+
+}
+
+int32 UBatteryEventDecodeCommandlet::Main(const FString& Params) {
+
+	FString inPath;
+	if(!FParse::Value(*Params, TEXT("In="), inPath)) {
+		UE_LOG(LogClass, Error, TEXT("Usage: -run=BatteryEventDecode -In=<file.bevt> [-Out=<file.csv>]"));
+		return 1;
+	}
+
+	FString outPath;
+	if(!FParse::Value(*Params, TEXT("Out="), outPath)) {
+		outPath = FPaths::ChangeExtension(inPath, TEXT("csv"));
+	}
+
+	TArray<uint8> bytes;
+	if(!FFileHelper::LoadFileToArray(bytes, *inPath)) {
+		UE_LOG(LogClass, Error, TEXT("Can't read event log %s"), *inPath);
+		return 1;
+	}
+
+	FMemoryReader reader(bytes);
+	uint32 magic = 0;
+	uint32 version = 0;
+	uint32 recordSize = 0;
+	reader << magic << version << recordSize;
+	if(reader.IsError() || magic != FBatteryEventLog::Magic || version != FBatteryEventLog::Version || recordSize != sizeof(FBatteryEventRecord)) {
+		UE_LOG(LogClass, Error, TEXT("%s is not an event log of this version"), *inPath);
+		return 1;
+	}
+
+	//A log cut off mid-record, e.g. by a killed server, still decodes up to the last whole one
+	const int32 count = (bytes.Num() - reader.Tell()) / sizeof(FBatteryEventRecord);
+	TArray<FBatteryEventRecord> records;
+	records.SetNumUninitialized(count);
+	reader.Serialize(records.GetData(), count * sizeof(FBatteryEventRecord));
+
+	//Rings are drained one after another, so only the order within a thread survives the file
+	records.StableSort([](const FBatteryEventRecord& a, const FBatteryEventRecord& b) {
+		return a.frame != b.frame ? a.frame < b.frame : a.time < b.time;
+	});
+
+	TArray<FString> lines;
+	lines.Reserve(count + 1);
+	lines.Add(TEXT("time,frame,thread,event,subject,other,detail,power,change,x,y,z"));
+	for(const FBatteryEventRecord& record : records) {
+		lines.Add(FString::Printf(TEXT("%.4f,%u,%u,%s,%u,%u,%u,%.2f,%.2f,%.1f,%.1f,%.1f"),
+			record.time, record.frame, record.thread, FBatteryEventLog::GetEventName((eBatteryEvent::Type)record.type),
+			record.subject, record.other, record.detail, record.power, record.change,
+			record.location.X, record.location.Y, record.location.Z));
+	}
+
+	if(!FFileHelper::SaveStringArrayToFile(lines, *outPath)) {
+		UE_LOG(LogClass, Error, TEXT("Can't write %s"), *outPath);
+		return 1;
+	}
+
+	UE_LOG(LogClass, Display, TEXT("Decoded %d events from %s to %s"), count, *inPath, *outPath);
+	return 0;
+
+}
@@ -0,0 +1,21 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "Commandlets/Commandlet.h"
+#include "BatteryEventDecodeCommandlet.generated.h"
+
+/**
+ * Turns an event log written by FBatteryEventLog into a CSV, one row per event sorted by frame.
+ * Run with -run=BatteryEventDecode -In=<file.bevt> [-Out=<file.csv>], the CSV goes next to the log by default.
+ */
+UCLASS()
+class BATTERYCOLLECTOR_API UBatteryEventDecodeCommandlet : public UCommandlet {
+	GENERATED_BODY()
+
+public:
+	UBatteryEventDecodeCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+};
@@ -0,0 +1,236 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BatteryCollector.h"
+#include "BatteryEventLog.h"
+#include "BatteryPickup.h"
+#include "HAL/ThreadSafeBool.h"
+
+static_assert(sizeof(FBatteryEventRecord) == 40, "Event records are written as is, the decoder expects 40 bytes");
+
+namespace {
+	//Seconds between flushes. A ring holds a little over 4000 events, plenty for one thread in that time
+	const float FlushInterval = 0.05f;
+
+	//Written by its own thread only, read by the flush thread only. Head and tail run on and wrap, the masked values index the records
+	struct FEventRing {
+		static const uint32 Capacity = 4096;
+
+		FBatteryEventRecord records[Capacity];
+		volatile uint32 head;
+		volatile uint32 tail;
+		uint16 index;
+
+		FEventRing() : head(0), tail(0), index(0) {}
+	};
+
+	//Every ring ever made. Rings outlive their threads, a thread's slot in the list is only taken once
+	TArray<FEventRing*> GRings;
+	FCriticalSection GRingsLock;
+	uint32 GRingTlsSlot = 0;
+	bool GbRingTlsAllocated = false;
+
+	FString GPath;
+	FArchive* GArchive = nullptr;
+	uint64 GWritten = 0;
+	volatile int32 GDropped = 0;
+
+	FEventRing* GetThreadRing() {
+
+		FEventRing* ring = (FEventRing*)FPlatformTLS::GetTlsValue(GRingTlsSlot);
+		if(ring == nullptr) {
+			//First event from this thread - the only time writing takes the lock
+			ring = new FEventRing();
+			FScopeLock lock(&GRingsLock);
+			ring->index = (uint16)GRings.Num();
+			GRings.Add(ring);
+			FPlatformTLS::SetTlsValue(GRingTlsSlot, ring);
+		}
+		return ring;
+
+	}
+
+	void DrainRings() {
+
+		TArray<FEventRing*> rings;
+		{
+			FScopeLock lock(&GRingsLock);
+			rings = GRings;
+		}
+
+		for(FEventRing* const ring : rings) {
+			const uint32 head = ring->head;
+			//Don't read the records before the head that covers them
+			FPlatformMisc::MemoryBarrier();
+
+			uint32 tail = ring->tail;
+			while(tail != head) {
+				const uint32 start = tail & (FEventRing::Capacity - 1);
+				const uint32 count = FMath::Min(head - tail, FEventRing::Capacity - start);
+				GArchive->Serialize(&ring->records[start], count * sizeof(FBatteryEventRecord));
+				tail += count;
+				GWritten += count;
+			}
+
+			//Finished with the records before the writer can reuse them
+			FPlatformMisc::MemoryBarrier();
+			ring->tail = tail;
+		}
+
+		GArchive->Flush();
+
+	}
+
+	class FEventFlusher : public FRunnable {
+
+	public:
+		virtual uint32 Run() override {
+			while(!m_bStopping) {
+				DrainRings();
+				FPlatformProcess::Sleep(FlushInterval);
+			}
+			return 0;
+		}
+
+		virtual void Stop() override {
+			m_bStopping = true;
+		}
+
+	private:
+		FThreadSafeBool m_bStopping;
+
+	};
+
+	FEventFlusher* GFlusher = nullptr;
+	FRunnableThread* GFlushThread = nullptr;
+}
+
+
+volatile bool FBatteryEventLog::s_bRunning = false;
+
+bool FBatteryEventLog::Start() {
+
+	if(s_bRunning) {
+		return true;
+	}
+
+	if(!FPlatformProcess::SupportsMultithreading()) {
+		UE_LOG(LogClass, Warning, TEXT("The event log needs a flush thread, it can't run on this platform"));
+		return false;
+	}
+
+	if(!GbRingTlsAllocated) {
+		GRingTlsSlot = FPlatformTLS::AllocTlsSlot();
+		GbRingTlsAllocated = true;
+	}
+
+	//Anything written as the last log stopped belongs to neither file
+	{
+		FScopeLock lock(&GRingsLock);
+		for(FEventRing* const ring : GRings) {
+			ring->tail = ring->head;
+		}
+	}
+
+	GPath = FPaths::ProfilingDir() / TEXT("BatteryEvents") / FString::Printf(TEXT("BatteryEvents-%s.bevt"), *FDateTime::Now().ToString());
+	GArchive = IFileManager::Get().CreateFileWriter(*GPath);
+	if(GArchive == nullptr) {
+		UE_LOG(LogClass, Warning, TEXT("Can't write event log %s"), *GPath);
+		return false;
+	}
+
+	uint32 magic = Magic;
+	uint32 version = Version;
+	uint32 recordSize = sizeof(FBatteryEventRecord);
+	*GArchive << magic << version << recordSize;
+
+	GWritten = 0;
+	GDropped = 0;
+
+	GFlusher = new FEventFlusher();
+	GFlushThread = FRunnableThread::Create(GFlusher, TEXT("BatteryEventFlush"), 0, TPri_BelowNormal);
+
+	s_bRunning = true;
+	UE_LOG(LogClass, Log, TEXT("Logging gameplay events to %s"), *GPath);
+
+	return true;
+
+}
+
+void FBatteryEventLog::Stop() {
+
+	if(!s_bRunning) {
+		return;
+	}
+
+	s_bRunning = false;
+
+	GFlushThread->Kill(true);
+	delete GFlushThread;
+	GFlushThread = nullptr;
+	delete GFlusher;
+	GFlusher = nullptr;
+
+	//The flush thread is gone, what is left gets written from here
+	DrainRings();
+
+	GArchive->Close();
+	delete GArchive;
+	GArchive = nullptr;
+
+	UE_LOG(LogClass, Log, TEXT("Event log %s closed: %llu events written, %d dropped on full rings"), *GPath, GWritten, GDropped);
+
+}
+
+FString FBatteryEventLog::GetPath() {
+	return GPath;
+}
+
+const TCHAR* FBatteryEventLog::GetEventName(eBatteryEvent::Type type) {
+
+	switch(type) {
+		case eBatteryEvent::eSpawn: return TEXT("Spawn");
+		case eBatteryEvent::eCollect: return TEXT("Collect");
+		case eBatteryEvent::ePowerChange: return TEXT("PowerChange");
+		case eBatteryEvent::eStateChange: return TEXT("StateChange");
+		default: return TEXT("Unknown");
+	}
+
+}
+
+void FBatteryEventLog::WriteSpawn(APickup* pickup) {
+
+	ABatteryPickup* const battery = Cast<ABatteryPickup>(pickup);
+	Write(eBatteryEvent::eSpawn, pickup, nullptr, 0, battery ? battery->GetPower() : 0.0f, 0.0f);
+
+}
+
+void FBatteryEventLog::Write(eBatteryEvent::Type type, const AActor* subject, const AActor* other, uint8 detail, float power, float change) {
+
+	FEventRing* const ring = GetThreadRing();
+
+	//Full - drop it rather than wait on the flush thread
+	const uint32 head = ring->head;
+	if(head - ring->tail >= FEventRing::Capacity) {
+		FPlatformAtomics::InterlockedIncrement(&GDropped);
+		return;
+	}
+
+	const UWorld* const world = subject ? subject->GetWorld() : nullptr;
+
+	FBatteryEventRecord& record = ring->records[head & (FEventRing::Capacity - 1)];
+	record.time = world ? world->GetTimeSeconds() : 0.0f;
+	record.frame = (uint32)GFrameCounter;
+	record.subject = subject ? subject->GetUniqueID() : 0;
+	record.other = other ? other->GetUniqueID() : 0;
+	record.type = (uint8)type;
+	record.detail = detail;
+	record.thread = ring->index;
+	record.power = power;
+	record.change = change;
+	record.location = subject ? subject->GetActorLocation() : FVector::ZeroVector;
+
+	//The record has to be whole before the flush thread sees the new head
+	FPlatformMisc::MemoryBarrier();
+	ring->head = head + 1;
+
+}
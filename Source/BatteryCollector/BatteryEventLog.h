@@ -0,0 +1,95 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+namespace eBatteryEvent {
+	enum Type {
+		//A pickup went into the level: power, location
+		eSpawn,
+		//A pickup was collected: other is the collector, power, location
+		eCollect,
+		//A player's power changed: detail is the ePowerChangeReason, power after it and the change
+		ePowerChange,
+		//The match changed state: detail is the eBatteryPlayState
+		eStateChange,
+		eCount
+	};
+}
+
+//One event as it goes into the file, 40 bytes whatever the type
+struct FBatteryEventRecord {
+	//Game time and frame it happened in
+	float time;
+	uint32 frame;
+	//Unique ids of the actor it happened to and of the other actor involved, 0 for none
+	uint32 subject;
+	uint32 other;
+	//eBatteryEvent::Type
+	uint8 type;
+	//Extra detail for the type, see eBatteryEvent
+	uint8 detail;
+	//Ring it was written to, one for each thread that writes events
+	uint16 thread;
+	float power;
+	float change;
+	FVector location;
+};
+
+/**
+ * Binary gameplay event log, for tracing a long or busy match without a log line per pickup. Each thread that writes
+ * events gets its own ring of fixed-size records, which only that thread writes and only the flush thread reads, so
+ * writing an event takes no lock. The flush thread drains the rings into Saved/Profiling/BatteryEvents a few times
+ * a second; when a ring is full the event is dropped and counted rather than stalling the game.
+ *
+ * Layout: magic, version, record size, then the records as they were drained - ordered within a thread but not across
+ * threads. The BatteryEventDecode commandlet turns a file into a CSV.
+ */
+class BATTERYCOLLECTOR_API FBatteryEventLog {
+
+public:
+	static const uint32 Magic = 0x54564542; // "BEVT"
+	static const uint32 Version = 1;
+
+	//Open a new file and start the flush thread. Headless runs can start it with -BatteryEventLog
+	static bool Start();
+
+	//Flush what is left and close the file
+	static void Stop();
+
+	FORCEINLINE static bool IsRunning() { return s_bRunning; }
+
+	static FString GetPath();
+
+	FORCEINLINE static void LogSpawn(class APickup* pickup) {
+		if(s_bRunning) {
+			WriteSpawn(pickup);
+		}
+	}
+
+	FORCEINLINE static void LogCollect(const AActor* pickup, const AActor* collector, float power) {
+		if(s_bRunning) {
+			Write(eBatteryEvent::eCollect, pickup, collector, 0, power, 0.0f);
+		}
+	}
+
+	FORCEINLINE static void LogPowerChange(const AActor* character, uint8 reason, float power, float change) {
+		if(s_bRunning) {
+			Write(eBatteryEvent::ePowerChange, character, nullptr, reason, power, change);
+		}
+	}
+
+	FORCEINLINE static void LogStateChange(const AActor* gameMode, uint8 state) {
+		if(s_bRunning) {
+			Write(eBatteryEvent::eStateChange, gameMode, nullptr, state, 0.0f, 0.0f);
+		}
+	}
+
+	static const TCHAR* GetEventName(eBatteryEvent::Type type);
+
+private:
+	static void WriteSpawn(class APickup* pickup);
+	static void Write(eBatteryEvent::Type type, const AActor* subject, const AActor* other, uint8 detail, float power, float change);
+
+	static volatile bool s_bRunning;
+
+};
@@ -0,0 +1,116 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BatteryCollector.h"
+#include "BatteryHUDWidget.h"
+#include "BatteryCollectorCharacter.h"
+#include "BatteryCollectorStats.h"
+
+
+UBatteryHUDWidget::UBatteryHUDWidget(const FObjectInitializer& ObjectInitializer) : Super(ObjectInitializer) {
+
+	maxUpdatesPerSecond = 10.0f;
+	powerDisplayEpsilon = 1.0f;
+	m_displayedPower = 0.0f;
+	m_timeSincePowerRead = 0.0f;
+
+}
+
+void UBatteryHUDWidget::NativeConstruct() {
+
+	Super::NativeConstruct();
+
+	//Only the game mode's world has one, clients without it just show no target
+	ABatteryCollectorGameMode* const gameMode = GetWorld() ? GetWorld()->GetAuthGameMode<ABatteryCollectorGameMode>() : nullptr;
+	if(gameMode) {
+		m_gameMode = gameMode;
+		m_playStateChangedHandle = gameMode->OnPlayStateChanged.AddUObject(this, &UBatteryHUDWidget::OnPlayStateChanged);
+		OnPlayStateDisplayChanged(gameMode->GetCurrentState());
+	}
+
+	BindCharacter(Cast<ABatteryCollectorCharacter>(GetOwningPlayerPawn()));
+
+}
+
+void UBatteryHUDWidget::NativeDestruct() {
+
+	BindCharacter(nullptr);
+
+	if(m_gameMode.IsValid()) {
+		m_gameMode->OnPlayStateChanged.Remove(m_playStateChangedHandle);
+	}
+	m_gameMode.Reset();
+
+	Super::NativeDestruct();
+
+}
+
+void UBatteryHUDWidget::NativeTick(const FGeometry& MyGeometry, float InDeltaTime) {
+
+	Super::NativeTick(MyGeometry, InDeltaTime);
+
+	ABatteryCollectorCharacter* const character = Cast<ABatteryCollectorCharacter>(GetOwningPlayerPawn());
+	if(character != m_character.Get()) {
+		BindCharacter(character);
+	}
+
+	//Jumps arrive as events, only steady decay needs reading - and no faster than the display limit
+	if(character == nullptr || character->GetPowerDecayRate() <= 0.0f) {
+		return;
+	}
+
+	m_timeSincePowerRead += InDeltaTime;
+	if(m_timeSincePowerRead >= 1.0f / maxUpdatesPerSecond) {
+		m_timeSincePowerRead = 0.0f;
+		PushPower(false);
+	}
+
+}
+
+void UBatteryHUDWidget::BindCharacter(ABatteryCollectorCharacter* character) {
+
+	if(m_character.IsValid()) {
+		m_character->OnPowerChanged.Remove(m_powerChangedHandle);
+	}
+
+	m_character = character;
+	m_timeSincePowerRead = 0.0f;
+
+	if(character) {
+		m_powerChangedHandle = character->OnPowerChanged.AddUObject(this, &UBatteryHUDWidget::OnCharacterPowerChanged);
+		PushPower(true);
+	}
+
+}
+
+void UBatteryHUDWidget::OnCharacterPowerChanged(ABatteryCollectorCharacter* character) {
+
+	PushPower(false);
+
+}
+
+void UBatteryHUDWidget::OnPlayStateChanged(eBatteryPlayState newState) {
+
+	BATTERY_SCOPE_CYCLE_COUNTER(HUDUpdate);
+
+	OnPlayStateDisplayChanged(newState);
+
+}
+
+void UBatteryHUDWidget::PushPower(bool bForce) {
+
+	ABatteryCollectorCharacter* const character = m_character.Get();
+	if(character == nullptr) {
+		return;
+	}
+
+	const float power = character->GetCurrentPower();
+	if(!bForce && FMath::Abs(power - m_displayedPower) < powerDisplayEpsilon) {
+		return;
+	}
+
+	BATTERY_SCOPE_CYCLE_COUNTER(HUDUpdate);
+
+	m_displayedPower = power;
+	OnPowerDisplayChanged(power, character->GetInitialPower(), m_gameMode.IsValid() ? m_gameMode->GetPowerToWin() : 0.0f);
+
+}
@@ -0,0 +1,69 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "Blueprint/UserWidget.h"
+#include "BatteryCollectorGameMode.h"
+#include "BatteryHUDWidget.generated.h"
+
+/**
+ * Base class for the power HUD. Instead of property bindings polling the character every frame, the widget is told
+ * when power jumps or the play state changes, and only re-reads the decaying power a few times a second. Blueprint
+ * subclasses update their text and bars from the events below, so everything else can sit in an Invalidation Box and
+ * is only repainted when it actually changes.
+ */
+UCLASS()
+class BATTERYCOLLECTOR_API UBatteryHUDWidget : public UUserWidget {
+	GENERATED_BODY()
+
+public:
+	UBatteryHUDWidget(const FObjectInitializer& ObjectInitializer);
+
+	virtual void NativeConstruct() override;
+	virtual void NativeDestruct() override;
+	virtual void NativeTick(const FGeometry& MyGeometry, float InDeltaTime) override;
+
+	//Power last pushed to the display
+	UFUNCTION(BlueprintPure, Category = "HUD")
+	FORCEINLINE float GetDisplayedPower() const { return m_displayedPower; }
+
+protected:
+	//Most times a second decaying power is pushed to the display
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "HUD", meta = (ClampMin = "1.0"))
+	float maxUpdatesPerSecond;
+
+	//Power changes smaller than this are not pushed to the display
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "HUD", meta = (ClampMin = "0.0"))
+	float powerDisplayEpsilon;
+
+	//The displayed power should change
+	UFUNCTION(BlueprintImplementableEvent, Category = "HUD")
+	void OnPowerDisplayChanged(float currentPower, float initialPower, float powerToWin);
+
+	//The match state changed
+	UFUNCTION(BlueprintImplementableEvent, Category = "HUD")
+	void OnPlayStateDisplayChanged(eBatteryPlayState newState);
+
+private:
+	//Follow the owning player's character, which changes when it respawns
+	void BindCharacter(class ABatteryCollectorCharacter* character);
+
+	void OnCharacterPowerChanged(class ABatteryCollectorCharacter* character);
+
+	void OnPlayStateChanged(eBatteryPlayState newState);
+
+	//Send the character's power to the display if it moved by more than the epsilon
+	void PushPower(bool bForce);
+
+	TWeakObjectPtr<class ABatteryCollectorCharacter> m_character;
+	TWeakObjectPtr<ABatteryCollectorGameMode> m_gameMode;
+
+	FDelegateHandle m_powerChangedHandle;
+	FDelegateHandle m_playStateChangedHandle;
+
+	float m_displayedPower;
+
+	//Seconds since the decaying power was last read
+	float m_timeSincePowerRead;
+
+};
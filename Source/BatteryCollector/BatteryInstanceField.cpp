@@ -0,0 +1,159 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BatteryCollector.h"
+#include "BatteryInstanceField.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "BatteryPickup.h"
+#include "PickupPool.h"
+#include "BatteryEventLog.h"
+
+
+ABatteryInstanceField::ABatteryInstanceField()
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+}
+
+bool ABatteryInstanceField::DemoteBattery(ABatteryPickup* battery) {
+
+	//Only pooled batteries have somewhere to wait while they are instanced
+	if(battery == nullptr || !battery->IsPooled()) {
+		return false;
+	}
+
+	UStaticMesh* const mesh = battery->GetMesh()->GetStaticMesh();
+	if(mesh == nullptr) {
+		return false;
+	}
+
+	FInstancedBattery instanced;
+	instanced.pool = battery->GetPool();
+	instanced.component = GetComponentForMesh(mesh);
+	instanced.transform = battery->GetActorTransform();
+	instanced.power = battery->GetPower();
+
+	//Reuse a hidden instance before growing the component
+	TArray<int32>& freeInstances = m_freeInstances.FindOrAdd(instanced.component);
+	if(freeInstances.Num() > 0) {
+		instanced.instanceIndex = freeInstances.Pop(false);
+		instanced.component->UpdateInstanceTransform(instanced.instanceIndex, instanced.transform, true, true, true);
+	} else {
+		instanced.instanceIndex = instanced.component->AddInstanceWorldSpace(instanced.transform);
+	}
+
+	m_batteries.Add(instanced);
+
+	//Send the actor back to its pool, still counted as in use while the instance stands for it
+	battery->GetPool()->AddReservation();
+	battery->SetActive(false);
+
+	return true;
+
+}
+
+void ABatteryInstanceField::PromoteInRange(const TArray<FVector>& points, float range) {
+
+	const float rangeSquared = range * range;
+
+	for(int32 iBattery = m_batteries.Num() - 1; iBattery >= 0; iBattery--) {
+		const FInstancedBattery& instanced = m_batteries[iBattery];
+		const FVector location = instanced.transform.GetLocation();
+
+		bool bInRange = false;
+		for(const FVector& point : points) {
+			if(FVector::DistSquared(location, point) <= rangeSquared) {
+				bInRange = true;
+				break;
+			}
+		}
+
+		if(!bInRange) {
+			continue;
+		}
+
+		//If the pool is gone there is no actor to bring back, keep drawing the instance
+		UPickupPool* const pool = instanced.pool.Get();
+		ABatteryPickup* const battery = pool ? Cast<ABatteryPickup>(pool->AcquireReserved(location, instanced.transform.Rotator())) : nullptr;
+		if(battery == nullptr) {
+			continue;
+		}
+
+		battery->SetPower(instanced.power);
+		//It was resting when it was instanced, don't let it fall again
+		battery->Settle();
+		//Back as an actor, logged like any other spawn now it has its power
+		FBatteryEventLog::LogSpawn(battery);
+
+		FreeInstance(instanced.component, instanced.instanceIndex);
+		m_batteries.RemoveAtSwap(iBattery, 1, false);
+	}
+
+}
+
+int32 ABatteryInstanceField::GetInstanceCount() const {
+	return m_batteries.Num();
+}
+
+float ABatteryInstanceField::GetInstancedPower() const {
+
+	float totalPower = 0.0f;
+	for(const FInstancedBattery& instanced : m_batteries) {
+		totalPower += instanced.power;
+	}
+	return totalPower;
+
+}
+
+void ABatteryInstanceField::GetInstancedBatteries(TArray<FTransform>& outTransforms, TArray<float>& outPower, TArray<UPickupPool*>& outPools) const {
+
+	for(const FInstancedBattery& instanced : m_batteries) {
+		outTransforms.Add(instanced.transform);
+		outPower.Add(instanced.power);
+		outPools.Add(instanced.pool.Get());
+	}
+
+}
+
+void ABatteryInstanceField::ClearInstances() {
+
+	for(const FInstancedBattery& instanced : m_batteries) {
+		FreeInstance(instanced.component, instanced.instanceIndex);
+		if(instanced.pool.IsValid()) {
+			instanced.pool->CancelReservation();
+		}
+	}
+	m_batteries.Reset();
+
+}
+
+UHierarchicalInstancedStaticMeshComponent* ABatteryInstanceField::GetComponentForMesh(UStaticMesh* mesh) {
+
+	for(UHierarchicalInstancedStaticMeshComponent* const component : m_instanceComponents) {
+		if(component->GetStaticMesh() == mesh) {
+			return component;
+		}
+	}
+
+	//Render only - instanced batteries never simulate or block anything
+	UHierarchicalInstancedStaticMeshComponent* const component = NewObject<UHierarchicalInstancedStaticMeshComponent>(this);
+	component->SetStaticMesh(mesh);
+	component->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	component->SetupAttachment(RootComponent);
+	component->RegisterComponent();
+
+	m_instanceComponents.Add(component);
+
+	return component;
+
+}
+
+void ABatteryInstanceField::FreeInstance(UHierarchicalInstancedStaticMeshComponent* component, int32 instanceIndex) {
+
+	//Removing would shuffle the indices we hand out, so collapse the instance to nothing instead
+	const FTransform hiddenTransform(FQuat::Identity, GetActorLocation(), FVector::ZeroVector);
+	component->UpdateInstanceTransform(instanceIndex, hiddenTransform, true, true, true);
+
+	m_freeInstances.FindOrAdd(component).Add(instanceIndex);
+
+}
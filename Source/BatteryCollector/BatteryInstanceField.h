@@ -0,0 +1,66 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "GameFramework/Actor.h"
+#include "BatteryInstanceField.generated.h"
+
+/**
+ * Draws settled batteries far from every player as instances of one hierarchical instanced mesh per static mesh,
+ * with no per-instance physics. The battery actor goes back to its pool while it is instanced and is taken out
+ * again when a player comes close; the pool keeps its place meanwhile, so instances count against the pool's cap.
+ */
+UCLASS()
+class BATTERYCOLLECTOR_API ABatteryInstanceField : public AActor {
+	GENERATED_BODY()
+
+public:
+	ABatteryInstanceField();
+
+	//Swap a settled battery for an instance. Returns false if the battery can't be instanced
+	bool DemoteBattery(class ABatteryPickup* battery);
+
+	//Turn every instance within range of a point back into a battery actor
+	void PromoteInRange(const TArray<FVector>& points, float range);
+
+	//Number of batteries currently drawn as instances
+	UFUNCTION(BlueprintPure, Category = "Pickups")
+	int32 GetInstanceCount() const;
+
+	//Number of instanced mesh components - one draw call batch each
+	FORCEINLINE int32 GetInstancedComponentCount() const { return m_instanceComponents.Num(); }
+
+	//Total power held by instanced batteries
+	float GetInstancedPower() const;
+
+	//Where each instanced battery is, what it is worth and the pool its actor waits in
+	void GetInstancedBatteries(TArray<FTransform>& outTransforms, TArray<float>& outPower, TArray<class UPickupPool*>& outPools) const;
+
+	//Forget every instance and give up their places in the pools - their actors are already back in them
+	void ClearInstances();
+
+private:
+	//A battery drawn as an instance
+	struct FInstancedBattery {
+		TWeakObjectPtr<class UPickupPool> pool;
+		class UHierarchicalInstancedStaticMeshComponent* component;
+		int32 instanceIndex;
+		FTransform transform;
+		float power;
+	};
+
+	//Instanced mesh component drawing the given mesh, created on first use
+	class UHierarchicalInstancedStaticMeshComponent* GetComponentForMesh(class UStaticMesh* mesh);
+
+	//Hide an instance and keep its index for reuse
+	void FreeInstance(class UHierarchicalInstancedStaticMeshComponent* component, int32 instanceIndex);
+
+	UPROPERTY()
+	TArray<class UHierarchicalInstancedStaticMeshComponent*> m_instanceComponents;
+
+	TArray<FInstancedBattery> m_batteries;
+
+	//Hidden instance indices per component, reused before adding new instances
+	TMap<class UHierarchicalInstancedStaticMeshComponent*, TArray<int32>> m_freeInstances;
+
+};
@@ -2,13 +2,15 @@
 
 #include "BatteryCollector.h"
 #include "BatteryPickup.h"
+#include "PickupRegistry.h"
+#include "PickupTypeAsset.h"
 
 
 ABatteryPickup::ABatteryPickup() {
 
 	GetMesh()->SetSimulatePhysics(true);
 
-	//Base power level of the battery
+	//Base power level of the battery, pickup types set their own
 	batteryPower = 150.0f;
 
 }
@@ -16,11 +18,35 @@ ABatteryPickup::ABatteryPickup() {
 void ABatteryPickup::WasCollected_Implementation() {
 	//Use the base pickup behaviour
 	Super::WasCollected_Implementation();
-	//Destroy the battery
-	Destroy();
+	//Pooled batteries are returned to their pool when deactivated, only destroy the ones placed in the level
+	if(!IsPooled()) {
+		Destroy();
+	}
 }
 
 //report the power level of the battery
 float ABatteryPickup::GetPower() {
+	//Read from the registry while registered
+	if(GetRegistrySlot() != INDEX_NONE) {
+		return GetRegistry()->GetPower(GetRegistrySlot());
+	}
+	return batteryPower;
+}
+
+void ABatteryPickup::SetPower(float newPower) {
+	batteryPower = newPower;
+	if(GetRegistrySlot() != INDEX_NONE) {
+		GetRegistry()->SetPower(GetRegistrySlot(), newPower);
+	}
+}
+
+void ABatteryPickup::SetPickupType(UPickupTypeAsset* pickupType) {
+	Super::SetPickupType(pickupType);
+	if(pickupType) {
+		SetPower(pickupType->power);
+	}
+}
+
+float ABatteryPickup::GetPowerValue() const {
 	return batteryPower;
 }
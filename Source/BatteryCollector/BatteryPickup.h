@@ -22,8 +22,17 @@ public:
 	//Public way to access the battery's power level
 	float GetPower();
 
+	//Change how much power the battery gives
+	void SetPower(float newPower);
+
+	//Batteries also take the type's power
+	virtual void SetPickupType(class UPickupTypeAsset* pickupType) override;
+
 protected:
 
+	//Batteries are worth their battery power
+	virtual float GetPowerValue() const override;
+
 	//Set the amount of power the batter will give to the character
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Power", meta = (BlueprintProtected = "true"))
 	float batteryPower;
@@ -0,0 +1,186 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include <cfloat>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * The power rules of the match - decay, walk speed, winning and running out - in plain C++ with no engine types, so
+ * they can be stepped and benchmarked outside the engine (see Source/PowerSimBench). The character, the game mode and
+ * the player power table call these rather than keeping their own copies of the sums.
+ */
+
+//Where a player stands in the match
+enum class ePlayerPowerState : uint8_t {
+	ePlaying,
+	eWon,
+	eLost
+};
+
+namespace BatteryPowerSim {
+
+	//Power a player has to get past to win, as a multiple of the power they start with
+	const float WinPowerMultiplier = 1.25f;
+
+	//Power at or below this has run out
+	const float DepletedPower = 1.e-4f;
+
+	inline float PowerToWin(float initialPower) {
+		return initialPower * WinPowerMultiplier;
+	}
+
+	//The decay rate is the share of the starting power lost every second
+	inline float DecayPerSecond(float decayRate, float initialPower) {
+		return decayRate * initialPower;
+	}
+
+	//Decay is linear from a level at a timestamp, down to nothing
+	inline float PowerAt(float power, float timestamp, float decayPerSecond, float time) {
+		const float decayed = power - decayPerSecond * (time - timestamp);
+		return decayed > 0.0f ? decayed : 0.0f;
+	}
+
+	//Time a draining player runs out, FLT_MAX if they aren't draining
+	inline float DepletionTime(float power, float timestamp, float decayPerSecond) {
+		return decayPerSecond > 0.0f ? timestamp + power / decayPerSecond : FLT_MAX;
+	}
+
+	//Seconds until the power falls to the given level, 0 if it already has, negative if it never will
+	inline float TimeUntilPower(float currentPower, float decayPerSecond, float powerLevel) {
+		if(currentPower <= powerLevel) {
+			return 0.0f;
+		}
+		if(decayPerSecond <= 0.0f) {
+			return -1.0f;
+		}
+		return (currentPower - powerLevel) / decayPerSecond;
+	}
+
+	inline float WalkSpeed(float baseSpeed, float speedFactor, float power) {
+		return baseSpeed + speedFactor * power;
+	}
+
+	//Power only rises on a change, so this is checked when it changes
+	inline bool HasWon(float power, float powerToWin) {
+		return power > powerToWin;
+	}
+
+	inline bool HasRunOut(float power) {
+		return power <= DepletedPower;
+	}
+
+	//Defaults are the character's and the game mode's
+	struct FPowerRules {
+		float initialPower;
+		//Share of the starting power lost every second
+		float decayRate;
+		float baseSpeed;
+		float speedFactor;
+		//Seconds per step of FPowerSimulation
+		float stepSeconds;
+
+		FPowerRules() : initialPower(2000.0f), decayRate(0.01f), baseSpeed(10.0f), speedFactor(0.75f), stepSeconds(1.0f / 60.0f) {}
+	};
+
+	/**
+	 * A match's players stepped at a fixed rate, for tuning the rules and measuring them at scale. The game itself works
+	 * the same rules out on demand instead, since linear decay needs no stepping; stepping gives the same power to within
+	 * float rounding.
+	 */
+	class FPowerSimulation {
+
+	public:
+		explicit FPowerSimulation(const FPowerRules& rules = FPowerRules()) : m_rules(rules), m_accumulator(0.0f), m_steps(0) {}
+
+		//Add a player on their starting power, returns their index
+		int32_t Add() {
+			m_power.push_back(m_rules.initialPower);
+			m_speed.push_back(WalkSpeed(m_rules.baseSpeed, m_rules.speedFactor, m_rules.initialPower));
+			m_state.push_back((uint8_t)ePlayerPowerState::ePlaying);
+			return (int32_t)m_power.size() - 1;
+		}
+
+		void Reserve(size_t count) {
+			m_power.reserve(count);
+			m_speed.reserve(count);
+			m_state.reserve(count);
+		}
+
+		//A player collected some power - the only way to win, so the win is checked here
+		void Collect(int32_t index, float power) {
+			if(m_state[index] != (uint8_t)ePlayerPowerState::ePlaying) {
+				return;
+			}
+			m_power[index] += power;
+			m_speed[index] = WalkSpeed(m_rules.baseSpeed, m_rules.speedFactor, m_power[index]);
+			if(HasWon(m_power[index], PowerToWin(m_rules.initialPower))) {
+				m_state[index] = (uint8_t)ePlayerPowerState::eWon;
+			}
+		}
+
+		//Run as many whole steps as fit in the time so far, the rest carries over. Returns the steps run
+		int32_t Advance(float seconds) {
+			m_accumulator += seconds;
+			int32_t steps = 0;
+			while(m_accumulator >= m_rules.stepSeconds) {
+				Step();
+				m_accumulator -= m_rules.stepSeconds;
+				steps++;
+			}
+			return steps;
+		}
+
+		//One step for every player. Branch free over plain arrays, so it vectorises
+		void Step() {
+			const float decayStep = DecayPerSecond(m_rules.decayRate, m_rules.initialPower) * m_rules.stepSeconds;
+			const float baseSpeed = m_rules.baseSpeed;
+			const float speedFactor = m_rules.speedFactor;
+			const size_t count = m_power.size();
+			float* const power = m_power.data();
+			float* const speed = m_speed.data();
+			uint8_t* const state = m_state.data();
+
+			for(size_t index = 0; index < count; index++) {
+				const bool bPlaying = state[index] == (uint8_t)ePlayerPowerState::ePlaying;
+				float stepped = power[index] - (bPlaying ? decayStep : 0.0f);
+				stepped = stepped > 0.0f ? stepped : 0.0f;
+				power[index] = stepped;
+				speed[index] = baseSpeed + speedFactor * stepped;
+				state[index] = bPlaying && HasRunOut(stepped) ? (uint8_t)ePlayerPowerState::eLost : state[index];
+			}
+
+			m_steps++;
+		}
+
+		int32_t Count(ePlayerPowerState playerState) const {
+			int32_t count = 0;
+			for(const uint8_t state : m_state) {
+				count += state == (uint8_t)playerState ? 1 : 0;
+			}
+			return count;
+		}
+
+		inline int32_t Num() const { return (int32_t)m_power.size(); }
+		inline float GetPower(int32_t index) const { return m_power[index]; }
+		inline float GetSpeed(int32_t index) const { return m_speed[index]; }
+		inline ePlayerPowerState GetState(int32_t index) const { return (ePlayerPowerState)m_state[index]; }
+		inline int64_t GetSteps() const { return m_steps; }
+		inline const FPowerRules& GetRules() const { return m_rules; }
+
+	private:
+		FPowerRules m_rules;
+
+		std::vector<float> m_power;
+		std::vector<float> m_speed;
+		//ePlayerPowerState
+		std::vector<uint8_t> m_state;
+
+		float m_accumulator;
+		int64_t m_steps;
+
+	};
+
+}
@@ -0,0 +1,216 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BatteryCollector.h"
+#include "BotDecisionSystem.h"
+#include "BatteryBotController.h"
+#include "PickupRegistry.h"
+#include "BatteryCollectorStats.h"
+#include "Async/ParallelFor.h"
+
+namespace {
+	//Spread the first decisions of new bots over this many slices of the interval
+	const int32 DecisionPhases = 16;
+}
+
+
+FPickupSnapshot::FPickupSnapshot() {
+
+	m_searchRadius = 1.0f;
+
+}
+
+void FPickupSnapshot::Build(FPickupRegistry& registry, float searchRadius) {
+
+	m_searchRadius = FMath::Max(searchRadius, 1.0f);
+
+	m_gatherSlots.Reset();
+	m_gatherPositions.Reset();
+	m_gatherPower.Reset();
+	registry.GatherActive(m_gatherSlots, m_gatherPositions, m_gatherPower);
+
+	//Sort by cell so every cell is one run of the arrays
+	const int32 count = m_gatherSlots.Num();
+	m_order.Reset(count);
+	for(int32 index = 0; index < count; index++) {
+		const FVector& position = m_gatherPositions[index];
+		m_order.Emplace(GetCellKey(FMath::FloorToInt(position.X / m_searchRadius), FMath::FloorToInt(position.Y / m_searchRadius)), index);
+	}
+	m_order.Sort([](const TPair<uint64, int32>& a, const TPair<uint64, int32>& b) {
+		return a.Key < b.Key;
+	});
+
+	m_slots.Reset(count);
+	m_positions.Reset(count);
+	m_power.Reset(count);
+	m_cells.Reset();
+
+	FIntPoint* cell = nullptr;
+	uint64 cellKey = 0;
+	for(int32 index = 0; index < count; index++) {
+		const TPair<uint64, int32>& entry = m_order[index];
+		if(cell == nullptr || entry.Key != cellKey) {
+			cellKey = entry.Key;
+			cell = &m_cells.Add(cellKey, FIntPoint(index, 0));
+		}
+		cell->Y++;
+
+		m_slots.Add(m_gatherSlots[entry.Value]);
+		m_positions.Add(m_gatherPositions[entry.Value]);
+		m_power.Add(m_gatherPower[entry.Value]);
+	}
+
+}
+
+int32 FPickupSnapshot::FindBestTarget(const FVector& location) const {
+
+	const int32 cellX = FMath::FloorToInt(location.X / m_searchRadius);
+	const int32 cellY = FMath::FloorToInt(location.Y / m_searchRadius);
+	const float radiusSquared = m_searchRadius * m_searchRadius;
+
+	int32 bestIndex = INDEX_NONE;
+	float bestScore = 0.0f;
+
+	for(int32 offsetX = -1; offsetX <= 1; offsetX++) {
+		for(int32 offsetY = -1; offsetY <= 1; offsetY++) {
+			const FIntPoint* const cell = m_cells.Find(GetCellKey(cellX + offsetX, cellY + offsetY));
+			if(cell == nullptr) {
+				continue;
+			}
+
+			for(int32 index = cell->X; index < cell->X + cell->Y; index++) {
+				const float distanceSquared = FVector::DistSquared(m_positions[index], location);
+				if(distanceSquared > radiusSquared) {
+					continue;
+				}
+
+				//Power for the distance walked, the extra metre keeps batteries underfoot from dividing by nothing
+				const float score = m_power[index] / (FMath::Sqrt(distanceSquared) + 100.0f);
+				if(score > bestScore) {
+					bestScore = score;
+					bestIndex = index;
+				}
+			}
+		}
+	}
+
+	return bestIndex;
+
+}
+
+FBox FPickupSnapshot::GetBounds() const {
+
+	return FBox(m_positions);
+
+}
+
+
+FBotDecisionSystem::FBotDecisionSystem() {
+
+	m_decisionInterval = 0.25f;
+	m_searchRadius = 3000.0f;
+	m_bParallel = true;
+
+}
+
+void FBotDecisionSystem::Initialize(float decisionInterval, float searchRadius, bool bParallel) {
+
+	m_decisionInterval = FMath::Max(decisionInterval, 0.0f);
+	m_searchRadius = FMath::Max(searchRadius, 1.0f);
+	m_bParallel = bParallel;
+
+}
+
+void FBotDecisionSystem::AddBot(ABatteryBotController* bot, float now) {
+
+	const bool bKnown = m_bots.ContainsByPredicate([bot](const FBotState& state) {
+		return state.controller == bot;
+	});
+	if(bKnown) {
+		return;
+	}
+
+	//Staggered, so bots added together don't all decide in the same frame from then on
+	FBotState state;
+	state.controller = bot;
+	state.nextDecisionTime = now + m_decisionInterval * (m_bots.Num() % DecisionPhases) / DecisionPhases;
+	state.targetSlot = INDEX_NONE;
+	state.targetLocation = FVector::ZeroVector;
+	m_bots.Add(state);
+
+}
+
+void FBotDecisionSystem::RemoveBot(ABatteryBotController* bot) {
+
+	m_bots.RemoveAll([bot](const FBotState& state) {
+		return state.controller == bot;
+	});
+
+}
+
+void FBotDecisionSystem::Update(FPickupRegistry& registry, float now, float deltaTime) {
+
+	BATTERY_SCOPE_CYCLE_COUNTER(BotDecisions);
+
+	m_bots.RemoveAll([](const FBotState& state) {
+		return !state.controller.IsValid();
+	});
+
+	//Where the bots due a decision are
+	m_dueBots.Reset();
+	m_dueLocations.Reset();
+	for(int32 iBot = 0; iBot < m_bots.Num(); iBot++) {
+		FBotState& bot = m_bots[iBot];
+		APawn* const pawn = bot.controller->GetPawn();
+		if(pawn == nullptr) {
+			continue;
+		}
+
+		//Someone else got there first, think again straight away
+		if(bot.targetSlot != INDEX_NONE && (bot.targetSlot >= registry.GetSlotCount() || !registry.IsActive(bot.targetSlot))) {
+			bot.targetSlot = INDEX_NONE;
+			bot.nextDecisionTime = now;
+		}
+
+		if(now >= bot.nextDecisionTime) {
+			m_dueBots.Add(iBot);
+			m_dueLocations.Add(pawn->GetActorLocation());
+			bot.nextDecisionTime = now + m_decisionInterval;
+		}
+	}
+
+	//Workers only read the snapshot and each write their own result
+	if(m_dueBots.Num() > 0) {
+		m_snapshot.Build(registry, m_searchRadius);
+
+		double busySeconds = 0.0;
+		DecideTargets(m_snapshot, m_dueLocations, m_dueTargets, m_bParallel, busySeconds);
+
+		for(int32 iDue = 0; iDue < m_dueBots.Num(); iDue++) {
+			FBotState& bot = m_bots[m_dueBots[iDue]];
+			const int32 target = m_dueTargets[iDue];
+			bot.targetSlot = target != INDEX_NONE ? m_snapshot.GetSlot(target) : INDEX_NONE;
+			bot.targetLocation = target != INDEX_NONE ? m_snapshot.GetPosition(target) : FVector::ZeroVector;
+		}
+	}
+
+	//Movement and collecting touch actors, so they stay on the game thread
+	for(const FBotState& bot : m_bots) {
+		bot.controller->Steer(bot.targetSlot != INDEX_NONE ? &bot.targetLocation : nullptr, deltaTime);
+	}
+
+}
+
+void FBotDecisionSystem::DecideTargets(const FPickupSnapshot& snapshot, const TArray<FVector>& locations, TArray<int32>& outTargets, bool bParallel, double& outBusySeconds) const {
+
+	outTargets.SetNumUninitialized(locations.Num());
+	volatile int64 busyCycles = 0;
+
+	ParallelFor(locations.Num(), [&](int32 index) {
+		const uint32 startCycles = FPlatformTime::Cycles();
+		outTargets[index] = snapshot.FindBestTarget(locations[index]);
+		FPlatformAtomics::InterlockedAdd(&busyCycles, (int64)(FPlatformTime::Cycles() - startCycles));
+	}, !bParallel);
+
+	outBusySeconds = FPlatformTime::GetSecondsPerCycle() * busyCycles;
+
+}
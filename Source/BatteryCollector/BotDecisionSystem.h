@@ -0,0 +1,105 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+/**
+ * Read-only copy of the active pickups, filed into a grid of search-radius sized cells so a bot only looks at the
+ * nine cells around it. Built on the game thread once a frame and then only read, so any number of workers can query
+ * it at once.
+ */
+class BATTERYCOLLECTOR_API FPickupSnapshot {
+
+public:
+	FPickupSnapshot();
+
+	//Copy the registry's active pickups. Cells are searchRadius across
+	void Build(class FPickupRegistry& registry, float searchRadius);
+
+	/**
+	 * Best pickup for a bot at the given location - the most power for the distance it has to walk
+	 * @return	Index into the snapshot, INDEX_NONE if nothing is in range
+	 */
+	int32 FindBestTarget(const FVector& location) const;
+
+	FORCEINLINE int32 Num() const { return m_positions.Num(); }
+	FORCEINLINE const FVector& GetPosition(int32 index) const { return m_positions[index]; }
+	FORCEINLINE int32 GetSlot(int32 index) const { return m_slots[index]; }
+
+	//Box around every pickup in the snapshot
+	FBox GetBounds() const;
+
+private:
+	FORCEINLINE uint64 GetCellKey(int32 cellX, int32 cellY) const { return ((uint64)(uint32)cellX << 32) | (uint32)cellY; }
+
+	float m_searchRadius;
+
+	//Pickups sorted by cell, so each cell is a run of indices
+	TArray<int32> m_slots;
+	TArray<FVector> m_positions;
+	TArray<float> m_power;
+
+	//First index and count of each occupied cell
+	TMap<uint64, FIntPoint> m_cells;
+
+	//Scratch for Build
+	TArray<int32> m_gatherSlots;
+	TArray<FVector> m_gatherPositions;
+	TArray<float> m_gatherPower;
+	TArray<TPair<uint64, int32>> m_order;
+
+};
+
+/**
+ * Target selection for every collector bot in the level. Once a frame the game mode builds a pickup snapshot; the bots
+ * due a new decision search it in parallel on task graph workers; then every bot is steered and collects on the game
+ * thread with the results. Decisions are staggered over the decision interval, so a frame only decides for a slice of
+ * the bots.
+ */
+class BATTERYCOLLECTOR_API FBotDecisionSystem {
+
+public:
+	FBotDecisionSystem();
+
+	void Initialize(float decisionInterval, float searchRadius, bool bParallel);
+
+	//Start deciding for a bot, its first decision comes within one interval of now
+	void AddBot(class ABatteryBotController* bot, float now);
+	void RemoveBot(class ABatteryBotController* bot);
+
+	FORCEINLINE int32 GetBotCount() const { return m_bots.Num(); }
+
+	//Decide for the bots that are due and steer them all - game thread
+	void Update(class FPickupRegistry& registry, float now, float deltaTime);
+
+	/**
+	 * Pick a target for each location from the snapshot
+	 * @param outTargets	Snapshot index for each location, INDEX_NONE when nothing is in range
+	 * @param outBusySeconds	Time spent deciding summed over every thread that took part
+	 */
+	void DecideTargets(const FPickupSnapshot& snapshot, const TArray<FVector>& locations, TArray<int32>& outTargets, bool bParallel, double& outBusySeconds) const;
+
+	FORCEINLINE FPickupSnapshot& GetSnapshot() { return m_snapshot; }
+
+private:
+	struct FBotState {
+		TWeakObjectPtr<class ABatteryBotController> controller;
+		float nextDecisionTime;
+		//Registry slot of the target and where it was, INDEX_NONE to wander
+		int32 targetSlot;
+		FVector targetLocation;
+	};
+
+	TArray<FBotState> m_bots;
+
+	FPickupSnapshot m_snapshot;
+
+	float m_decisionInterval;
+	float m_searchRadius;
+	bool m_bParallel;
+
+	//Scratch for Update
+	TArray<int32> m_dueBots;
+	TArray<FVector> m_dueLocations;
+	TArray<int32> m_dueTargets;
+
+};
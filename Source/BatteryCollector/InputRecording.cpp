@@ -0,0 +1,155 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BatteryCollector.h"
+#include "InputRecording.h"
+
+namespace {
+	const uint32 RecordingMagic = 0x52494342; // "BCIR"
+	const uint32 RecordingVersion = 1;
+	const int32 DefaultSeed = 1;
+	const int32 DefaultFPS = 30;
+}
+
+
+FInputRecording::FInputRecording() {
+
+	m_mode = eMode::eOff;
+	m_archive = nullptr;
+	m_framesDone = 0;
+
+}
+
+FInputRecording::~FInputRecording() {
+
+	Close();
+
+}
+
+void FInputRecording::InitFromCommandLine() {
+
+	const TCHAR* const commandLine = FCommandLine::Get();
+	FString name;
+	int32 seed = DefaultSeed;
+	int32 fps = DefaultFPS;
+
+	if(FParse::Value(commandLine, TEXT("BatteryReplayInput="), name)) {
+		m_archive = IFileManager::Get().CreateFileReader(*GetRecordingPath(name));
+		if(m_archive == nullptr || !ReadHeader(*m_archive, seed, fps)) {
+			UE_LOG(LogClass, Warning, TEXT("Can't replay input recording %s"), *name);
+			Close();
+			return;
+		}
+		m_mode = eMode::eReplaying;
+	} else if(FParse::Value(commandLine, TEXT("BatteryRecordInput="), name)) {
+		GetSessionSeed(seed);
+		FParse::Value(commandLine, TEXT("BatteryInputFPS="), fps);
+		fps = FMath::Max(fps, 1);
+
+		m_archive = IFileManager::Get().CreateFileWriter(*GetRecordingPath(name));
+		if(m_archive == nullptr) {
+			UE_LOG(LogClass, Warning, TEXT("Can't write input recording %s"), *name);
+			return;
+		}
+
+		uint32 magic = RecordingMagic;
+		uint32 version = RecordingVersion;
+		*m_archive << magic << version << seed << fps;
+		m_mode = eMode::eRecording;
+	} else {
+		return;
+	}
+
+	//Frames only line up between runs if every frame simulates the same time
+	FApp::SetUseFixedTimeStep(true);
+	FApp::SetFixedDeltaTime(1.0 / fps);
+
+	UE_LOG(LogClass, Log, TEXT("%s input %s (seed %d, %d fps)"), m_mode == eMode::eRecording ? TEXT("Recording") : TEXT("Replaying"), *name, seed, fps);
+
+}
+
+void FInputRecording::Close() {
+
+	if(m_archive) {
+		m_archive->Close();
+		delete m_archive;
+		m_archive = nullptr;
+	}
+
+	if(m_mode != eMode::eOff) {
+		UE_LOG(LogClass, Log, TEXT("Input recording closed after %d frames"), m_framesDone);
+		m_mode = eMode::eOff;
+	}
+
+}
+
+void FInputRecording::WriteFrame(const FRecordedInputFrame& frame) {
+
+	check(m_mode == eMode::eRecording);
+
+	FRecordedInputFrame stored = frame;
+	*m_archive << stored.moveForward << stored.moveRight << stored.turn << stored.lookUp << stored.actions;
+	m_framesDone++;
+
+}
+
+bool FInputRecording::ReadFrame(FRecordedInputFrame& outFrame) {
+
+	check(m_mode == eMode::eReplaying);
+
+	if(m_archive->AtEnd()) {
+		return false;
+	}
+
+	*m_archive << outFrame.moveForward << outFrame.moveRight << outFrame.turn << outFrame.lookUp << outFrame.actions;
+	m_framesDone++;
+
+	return !m_archive->IsError();
+
+}
+
+bool FInputRecording::GetSessionSeed(int32& outSeed) {
+
+	const TCHAR* const commandLine = FCommandLine::Get();
+
+	if(FParse::Value(commandLine, TEXT("BatterySeed="), outSeed)) {
+		return true;
+	}
+
+	//A replay has to use the seed it was recorded with
+	FString name;
+	if(FParse::Value(commandLine, TEXT("BatteryReplayInput="), name)) {
+		TUniquePtr<FArchive> archive(IFileManager::Get().CreateFileReader(*GetRecordingPath(name)));
+		int32 fps;
+		return archive.IsValid() && ReadHeader(*archive, outSeed, fps);
+	}
+
+	if(FParse::Value(commandLine, TEXT("BatteryRecordInput="), name)) {
+		outSeed = DefaultSeed;
+		return true;
+	}
+
+	return false;
+
+}
+
+FString FInputRecording::GetRecordingPath(const FString& name) {
+
+	return FPaths::GameSavedDir() / TEXT("InputRecordings") / name + TEXT(".bcinput");
+
+}
+
+bool FInputRecording::ReadHeader(FArchive& archive, int32& outSeed, int32& outFPS) {
+
+	uint32 magic = 0;
+	uint32 version = 0;
+	archive << magic << version;
+	if(magic != RecordingMagic || version != RecordingVersion) {
+		return false;
+	}
+
+	archive << outSeed << outFPS;
+	outFPS = FMath::Max(outFPS, 1);
+
+	return !archive.IsError();
+
+}
@@ -0,0 +1,90 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+//Bits of FRecordedInputFrame::actions
+namespace eRecordedAction {
+	enum Type : uint8 {
+		eJumpPressed = 1 << 0,
+		eJumpReleased = 1 << 1,
+		eCollectPressed = 1 << 2
+	};
+}
+
+//Player input for a single frame, quantized the way it is stored on disk
+struct FRecordedInputFrame {
+	//MoveForward and MoveRight axes scaled to -127..127
+	int8 moveForward;
+	int8 moveRight;
+
+	//Yaw and pitch added to the control rotation this frame, from both the mouse and rate axes
+	FFloat16 turn;
+	FFloat16 lookUp;
+
+	//eRecordedAction bits
+	uint8 actions;
+
+	FRecordedInputFrame() : moveForward(0), moveRight(0), turn(0.0f), lookUp(0.0f), actions(0) {}
+
+	static int8 QuantizeAxis(float value) { return (int8)FMath::Clamp(FMath::RoundToInt(value * 127.0f), -127, 127); }
+	static float DequantizeAxis(int8 value) { return value / 127.0f; }
+};
+
+/**
+ * Records player input to a compact binary file, or plays one back, so two builds can be run on the same workload.
+ *
+ * Record with -BatteryRecordInput=Name, replay with -BatteryReplayInput=Name (add -nullrhi -unattended to replay headless).
+ * Files live in Saved/InputRecordings. Both modes run on a fixed timestep (-BatteryInputFPS=N, default 30, stored
+ * in the file) and seed every spawn volume from one session seed (-BatterySeed=N, default 1, stored in the file).
+ *
+ * The game mode opens one recording per session and hands it to each pawn the first player possesses, so respawns carry
+ * on the same file.
+ *
+ * File layout: magic, version, seed, fps, then one 7 byte frame per game frame.
+ */
+class BATTERYCOLLECTOR_API FInputRecording {
+
+public:
+	enum class eMode : uint8 {
+		eOff,
+		eRecording,
+		eReplaying
+	};
+
+	FInputRecording();
+	~FInputRecording();
+
+	//Open a recording or replay if the command line asks for one
+	void InitFromCommandLine();
+
+	//Write the last frame out and close the file
+	void Close();
+
+	FORCEINLINE eMode GetMode() const { return m_mode; }
+	FORCEINLINE bool IsActive() const { return m_mode != eMode::eOff; }
+
+	//Append a frame - recording only
+	void WriteFrame(const FRecordedInputFrame& frame);
+
+	//Read the next frame - replaying only. Returns false at the end of the file
+	bool ReadFrame(FRecordedInputFrame& outFrame);
+
+	/**
+	 * Seed shared by every spawn volume this session
+	 * @return	False when neither a seed nor a recording was asked for, spawning stays unseeded
+	 */
+	static bool GetSessionSeed(int32& outSeed);
+
+private:
+	static FString GetRecordingPath(const FString& name);
+
+	//Read just the header of a recording
+	static bool ReadHeader(FArchive& archive, int32& outSeed, int32& outFPS);
+
+	eMode m_mode;
+
+	FArchive* m_archive;
+
+	int32 m_framesDone;
+
+};
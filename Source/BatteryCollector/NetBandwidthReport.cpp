@@ -0,0 +1,99 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BatteryCollector.h"
+#include "NetBandwidthReport.h"
+#include "Engine/NetDriver.h"
+#include "Engine/NetConnection.h"
+
+
+FNetBandwidthReport::FNetBandwidthReport() {
+
+	m_archive = nullptr;
+
+}
+
+FNetBandwidthReport::~FNetBandwidthReport() {
+
+	Close();
+
+}
+
+bool FNetBandwidthReport::Open() {
+
+	Close();
+	m_clients.Reset();
+
+	m_path = FPaths::ProfilingDir() / TEXT("NetBandwidth") / FString::Printf(TEXT("NetBandwidth-%s.csv"), *FDateTime::Now().ToString());
+	m_archive = IFileManager::Get().CreateFileWriter(*m_path);
+	if(m_archive == nullptr) {
+		UE_LOG(LogClass, Warning, TEXT("Can't write bandwidth report %s"), *m_path);
+		return false;
+	}
+
+	WriteLine(TEXT("time,client,outBytesPerSecond,inBytesPerSecond,outPacketsPerSecond,inPacketsPerSecond,actorChannels,pingMs"));
+
+	return true;
+
+}
+
+void FNetBandwidthReport::Close() {
+
+	if(m_archive == nullptr) {
+		return;
+	}
+
+	m_archive->Close();
+	delete m_archive;
+	m_archive = nullptr;
+
+	for(const TPair<FString, FClientTotals>& client : m_clients) {
+		const FClientTotals& totals = client.Value;
+		UE_LOG(LogClass, Log, TEXT("NetBandwidthReport %s: out avg %lld B/s peak %d B/s, in avg %lld B/s, peak %d actor channels over %d samples"),
+			*client.Key, totals.outBytesPerSecondSum / FMath::Max(totals.samples, 1), totals.peakOutBytesPerSecond,
+			totals.inBytesPerSecondSum / FMath::Max(totals.samples, 1), totals.peakActorChannels, totals.samples);
+	}
+
+	UE_LOG(LogClass, Log, TEXT("NetBandwidthReport written to %s"), *m_path);
+
+}
+
+void FNetBandwidthReport::Sample(UWorld* world) {
+
+	UNetDriver* const netDriver = world ? world->GetNetDriver() : nullptr;
+	if(m_archive == nullptr || netDriver == nullptr) {
+		return;
+	}
+
+	const float time = world->GetTimeSeconds();
+
+	for(UNetConnection* const connection : netDriver->ClientConnections) {
+		if(connection == nullptr) {
+			continue;
+		}
+
+		const FString client = connection->LowLevelGetRemoteAddress(true);
+		const APlayerState* const playerState = connection->PlayerController ? connection->PlayerController->PlayerState : nullptr;
+		//Player state ping is stored divided by four
+		const int32 pingMs = playerState ? playerState->Ping * 4 : 0;
+		const int32 actorChannels = connection->ActorChannels.Num();
+
+		WriteLine(FString::Printf(TEXT("%.3f,%s,%d,%d,%d,%d,%d,%d"), time, *client, connection->OutBytesPerSecond, connection->InBytesPerSecond,
+			connection->OutPacketsPerSecond, connection->InPacketsPerSecond, actorChannels, pingMs));
+
+		FClientTotals& totals = m_clients.FindOrAdd(client);
+		totals.samples++;
+		totals.outBytesPerSecondSum += connection->OutBytesPerSecond;
+		totals.peakOutBytesPerSecond = FMath::Max(totals.peakOutBytesPerSecond, connection->OutBytesPerSecond);
+		totals.inBytesPerSecondSum += connection->InBytesPerSecond;
+		totals.peakActorChannels = FMath::Max(totals.peakActorChannels, actorChannels);
+	}
+
+}
+
+void FNetBandwidthReport::WriteLine(const FString& line) {
+
+	FTCHARToUTF8 converted(*(line + LINE_TERMINATOR));
+	m_archive->Serialize((void*)converted.Get(), converted.Length());
+	m_archive->Flush();
+
+}
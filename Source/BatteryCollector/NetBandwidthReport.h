@@ -0,0 +1,54 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+/**
+ * Samples the bandwidth the server spends on each client connection into
+ * Saved/Profiling/NetBandwidth/NetBandwidth-<timestamp>.csv, and logs a per-client summary when closed.
+ *
+ * To size a host, run a local server and some headless clients, e.g.
+ *
+ *   BatteryCollector CollectionLevel -server -log -NetBandwidthReport=1
+ *   BatteryCollector 127.0.0.1 -game -nullrhi -nosound -unattended      (once per client)
+ *
+ * Connections update their byte and packet rates once a second, so sampling faster than that repeats rows.
+ */
+class BATTERYCOLLECTOR_API FNetBandwidthReport {
+
+public:
+	FNetBandwidthReport();
+	~FNetBandwidthReport();
+
+	//Open a new file. Returns false if the file can't be written
+	bool Open();
+
+	//Log the per-client summary and close the file
+	void Close();
+
+	FORCEINLINE bool IsOpen() const { return m_archive != nullptr; }
+
+	//Write a row for every client connected to the world's net driver
+	void Sample(UWorld* world);
+
+	FORCEINLINE const FString& GetPath() const { return m_path; }
+
+private:
+	//What one client has cost so far
+	struct FClientTotals {
+		int32 samples;
+		int64 outBytesPerSecondSum;
+		int32 peakOutBytesPerSecond;
+		int64 inBytesPerSecondSum;
+		int32 peakActorChannels;
+
+		FClientTotals() : samples(0), outBytesPerSecondSum(0), peakOutBytesPerSecond(0), inBytesPerSecondSum(0), peakActorChannels(0) {}
+	};
+
+	void WriteLine(const FString& line);
+
+	FArchive* m_archive;
+	FString m_path;
+
+	TMap<FString, FClientTotals> m_clients;
+
+};
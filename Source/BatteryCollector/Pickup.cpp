@@ -2,6 +2,13 @@
 
 #include "BatteryCollector.h"
 #include "Pickup.h"
+#include "PickupPool.h"
+#include "PickupRegistry.h"
+#include "BatteryCollectorGameMode.h"
+#include "BatteryCollectorStats.h"
+#include "PickupTypeAsset.h"
+#include "Kismet/GameplayStatics.h"
+#include "UnrealNetwork.h"
 
 
 // Sets default values
@@ -13,17 +20,63 @@ APickup::APickup()
 	//All pickups start active
 	bIsActive = true;
 
+	//Replicate while moving and go dormant once at rest, clients far from a pickup don't need it at all
+	bReplicates = true;
+	bReplicateMovement = true;
+	NetDormancy = DORM_Awake;
+	NetUpdateFrequency = 10.0f;
+	NetCullDistanceSquared = FMath::Square(8000.0f);
+
 	//Create the static mesh component
 	m_PickupMesh = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("PickupMesh"));
 	RootComponent = m_PickupMesh;
 
+	//We need to know when physics settles the pickup so the registry can file it
+	m_PickupMesh->BodyInstance.bGenerateWakeEvents = true;
+
+	m_owningPool = nullptr;
+	m_bParkedSimulatingPhysics = false;
+	m_registrySlot = INDEX_NONE;
+
+	//Resting pickups stop costing the physics scene after a couple of seconds
+	freezeDelay = 2.0f;
+	m_bFrozen = false;
+
+	m_bPredictedCollected = false;
+	m_poolGeneration = 0;
+	m_pickupType = nullptr;
+
 }
 
 // Called when the game starts or when spawned
 void APickup::BeginPlay()
 {
 	Super::BeginPlay();
-	
+
+	m_PickupMesh->OnComponentSleep.AddDynamic(this, &APickup::OnMeshSleep);
+	m_PickupMesh->OnComponentWake.AddDynamic(this, &APickup::OnMeshWake);
+	m_PickupMesh->OnComponentHit.AddDynamic(this, &APickup::OnMeshHit);
+
+	RegisterWithRegistry();
+
+}
+
+void APickup::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	UnregisterFromRegistry();
+
+	//Destroyed outside the pool, e.g. a simulating battery that fell out of the world
+	if(m_owningPool) {
+		m_owningPool->Remove(this);
+		m_owningPool = nullptr;
+	}
+
+	if(m_bFrozen) {
+		m_bFrozen = false;
+		BATTERY_DEC_COUNTER_BY(FrozenPickups, 1);
+	}
+
+	Super::EndPlay(EndPlayReason);
 }
 
 // Called every frame
@@ -33,17 +86,251 @@ void APickup::Tick(float DeltaTime)
 
 }
 
+void APickup::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(APickup, bIsActive);
+	DOREPLIFETIME(APickup, m_poolGeneration);
+	DOREPLIFETIME_CONDITION(APickup, m_pickupType, COND_InitialOnly);
+}
+
 bool APickup::IsActive() {
+	//SetActive keeps the registry's copy in step with this one
 	return bIsActive;
 }
 
 void APickup::SetActive(bool NewPickupState) {
+	WakeDormant();
 	bIsActive = NewPickupState;
+	if(m_registrySlot != INDEX_NONE) {
+		GetRegistry()->SetActive(m_registrySlot, bIsActive);
+	}
+
+	//Pooled pickups go back to their pool rather than lingering in the level
+	if(!bIsActive && m_owningPool) {
+		m_owningPool->Release(this);
+	}
+}
+
+void APickup::SetPool(UPickupPool* pool) {
+	m_owningPool = pool;
+}
+
+void APickup::ParkInPool() {
+	//Hidden pickups without collision stop being relevant, clients have to see them hidden first
+	WakeDormant();
+	UnregisterFromRegistry();
+	bIsActive = false;
+
+	//A frozen pickup was simulating as far as the pool is concerned
+	GetWorldTimerManager().ClearTimer(m_freezeTimer);
+	m_bParkedSimulatingPhysics = m_bParkedSimulatingPhysics || m_bFrozen || m_PickupMesh->IsSimulatingPhysics();
+	if(m_bFrozen) {
+		m_bFrozen = false;
+		m_PickupMesh->SetNotifyRigidBodyCollision(false);
+		BATTERY_DEC_COUNTER_BY(FrozenPickups, 1);
+	}
+	m_PickupMesh->SetSimulatePhysics(false);
+
+	SetActorHiddenInGame(true);
+	SetActorEnableCollision(false);
+}
+
+void APickup::UnparkFromPool(const FVector& location, const FRotator& rotation) {
+	SetActorLocationAndRotation(location, rotation, false, nullptr, ETeleportType::TeleportPhysics);
+
+	SetActorEnableCollision(true);
+	SetActorHiddenInGame(false);
+
+	if(m_bParkedSimulatingPhysics) {
+		//Don't carry velocity over from the pickup's last life
+		m_PickupMesh->SetSimulatePhysics(true);
+		m_PickupMesh->SetPhysicsLinearVelocity(FVector::ZeroVector);
+		m_PickupMesh->SetPhysicsAngularVelocity(FVector::ZeroVector);
+		m_bParkedSimulatingPhysics = false;
+	}
+
+	bIsActive = true;
+	m_poolGeneration++;
+	RegisterWithRegistry();
 }
 
 void APickup::WasCollected_Implementation() {
-	//Log a debug message
-	FString pickupDebugString = GetName();
-	UE_LOG(LogClass, Log, TEXT("You have collected %s"), *pickupDebugString);
+	//Collections go to the event log, this is only for watching one pickup by hand and builds nothing in shipping
+	UE_LOG(LogClass, Verbose, TEXT("You have collected %s"), *GetName());
+
+	//The type's effect was streamed in with the rest of it
+	UParticleSystem* const collectEffect = m_pickupType ? m_pickupType->collectEffect.Get() : nullptr;
+	if(collectEffect && GetNetMode() != NM_DedicatedServer) {
+		UGameplayStatics::SpawnEmitterAtLocation(this, collectEffect, GetActorLocation());
+	}
+}
+
+void APickup::SetPickupType(UPickupTypeAsset* pickupType) {
+	m_pickupType = pickupType;
+	ApplyPickupTypeMesh();
+}
+
+void APickup::OnRep_PickupType() {
+	if(m_pickupType == nullptr || m_pickupType->mesh.IsNull()) {
+		return;
+	}
+
+	//The server only spawns types it has loaded, a client may still be streaming this one in
+	if(m_pickupType->mesh.IsPending()) {
+		UPickupTypeAsset::GetStreamableManager().RequestAsyncLoad(m_pickupType->mesh.ToStringReference(), FStreamableDelegate::CreateUObject(this, &APickup::ApplyPickupTypeMesh));
+	} else {
+		ApplyPickupTypeMesh();
+	}
+}
+
+void APickup::ApplyPickupTypeMesh() {
+	UStaticMesh* const typeMesh = m_pickupType ? m_pickupType->mesh.Get() : nullptr;
+	if(typeMesh) {
+		m_PickupMesh->SetStaticMesh(typeMesh);
+	}
 }
 
+void APickup::Settle() {
+	if(m_PickupMesh->IsSimulatingPhysics()) {
+		m_PickupMesh->PutRigidBodyToSleep();
+	}
+	if(m_registrySlot != INDEX_NONE) {
+		GetRegistry()->SetSettled(m_registrySlot, true);
+	}
+}
+
+void APickup::SetPredictedCollected(bool bPredicted) {
+	m_bPredictedCollected = bPredicted;
+	m_PickupMesh->SetHiddenInGame(bPredicted);
+}
+
+void APickup::SetUnwatched(bool bUnwatched) {
+	if(bUnwatched) {
+		GoDormant();
+	} else if(!m_bFrozen && m_PickupMesh->IsSimulatingPhysics() && m_PickupMesh->RigidBodyIsAwake()) {
+		//A resting pickup goes on sleeping, a moving one has positions to send again
+		WakeDormant();
+	}
+}
+
+void APickup::OnRep_PoolGeneration() {
+	//Back out of the pool as a new pickup, whatever this client predicted about its last life is done with
+	if(m_bPredictedCollected) {
+		SetPredictedCollected(false);
+	}
+}
+
+void APickup::WakeFromFreeze() {
+	if(!m_bFrozen) {
+		return;
+	}
+
+	m_bFrozen = false;
+	WakeDormant();
+	m_PickupMesh->SetNotifyRigidBodyCollision(false);
+	m_PickupMesh->SetSimulatePhysics(true);
+	m_PickupMesh->WakeRigidBody();
+	BATTERY_DEC_COUNTER_BY(FrozenPickups, 1);
+
+	//Moving again, keep it out of the spatial index until it rests
+	if(m_registrySlot != INDEX_NONE) {
+		GetRegistry()->SetSettled(m_registrySlot, false);
+	}
+}
+
+void APickup::Freeze() {
+	//Only a body that is still asleep gets frozen
+	if(m_bFrozen || !m_PickupMesh->IsSimulatingPhysics() || m_PickupMesh->RigidBodyIsAwake()) {
+		return;
+	}
+
+	m_PickupMesh->SetSimulatePhysics(false);
+	//A non-simulating body only reports the hits we need to wake it while it is frozen
+	m_PickupMesh->SetNotifyRigidBodyCollision(true);
+	m_bFrozen = true;
+	BATTERY_INC_COUNTER_BY(FrozenPickups, 1);
+
+	GoDormant();
+}
+
+void APickup::GoDormant() {
+	if(Role == ROLE_Authority) {
+		SetNetDormancy(DORM_DormantAll);
+	}
+}
+
+void APickup::WakeDormant() {
+	if(Role == ROLE_Authority && NetDormancy > DORM_Awake) {
+		SetNetDormancy(DORM_Awake);
+	}
+}
+
+float APickup::GetPowerValue() const {
+	return 0.0f;
+}
+
+void APickup::RegisterWithRegistry() {
+	FPickupRegistry* const registry = GetRegistry();
+	if(registry == nullptr || m_registrySlot != INDEX_NONE) {
+		return;
+	}
+
+	const bool bSettled = !m_PickupMesh->IsSimulatingPhysics() || !m_PickupMesh->RigidBodyIsAwake();
+	m_registrySlot = registry->Register(this, registry->FindOrAddTypeId(GetClass()), GetPowerValue(), bIsActive, bSettled);
+}
+
+void APickup::UnregisterFromRegistry() {
+	if(m_registrySlot == INDEX_NONE) {
+		return;
+	}
+
+	FPickupRegistry* const registry = GetRegistry();
+	if(registry) {
+		//Carry state we dropped from the actor back onto it
+		bIsActive = registry->IsActive(m_registrySlot);
+		registry->Unregister(m_registrySlot);
+	}
+	m_registrySlot = INDEX_NONE;
+}
+
+FPickupRegistry* APickup::GetRegistry() const {
+	UWorld* const world = GetWorld();
+	ABatteryCollectorGameMode* const gameMode = world ? world->GetAuthGameMode<ABatteryCollectorGameMode>() : nullptr;
+	return gameMode ? &gameMode->GetPickupRegistry() : nullptr;
+}
+
+void APickup::OnMeshSleep(UPrimitiveComponent* SleepingComponent, FName BoneName) {
+	if(m_registrySlot != INDEX_NONE) {
+		GetRegistry()->SetSettled(m_registrySlot, true);
+	}
+
+	//The server decides when a pickup freezes, clients follow its replicated movement
+	if(Role < ROLE_Authority) {
+		return;
+	}
+
+	if(freezeDelay >= 0.0f) {
+		GetWorldTimerManager().SetTimer(m_freezeTimer, this, &APickup::Freeze, FMath::Max(freezeDelay, KINDA_SMALL_NUMBER), false);
+	} else {
+		//Never frozen, but still nothing to send while it rests
+		GoDormant();
+	}
+}
+
+void APickup::OnMeshWake(UPrimitiveComponent* WakingComponent, FName BoneName) {
+	if(m_registrySlot != INDEX_NONE) {
+		GetRegistry()->SetSettled(m_registrySlot, false);
+	}
+
+	GetWorldTimerManager().ClearTimer(m_freezeTimer);
+	WakeDormant();
+}
+
+void APickup::OnMeshHit(UPrimitiveComponent* HitComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit) {
+	//Bumped by a character or hit by another pickup
+	if(m_bFrozen && OtherActor != this) {
+		WakeFromFreeze();
+	}
+}
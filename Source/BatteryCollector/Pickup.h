@@ -17,10 +17,15 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	// Called when the pickup leaves the level
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 public:
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
 
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
 	//Return the mesh for the pickup
 	FORCEINLINE UStaticMeshComponent* GetMesh() const { return m_PickupMesh; }
 
@@ -36,14 +41,114 @@ public:
 	void WasCollected();
 	virtual void WasCollected_Implementation();
 
+	//Pool bookkeeping - a pooled pickup is parked instead of destroyed when deactivated
+	FORCEINLINE bool IsPooled() const { return m_owningPool != nullptr; }
+	FORCEINLINE class UPickupPool* GetPool() const { return m_owningPool; }
+	void SetPool(class UPickupPool* pool);
+
+	//Hide the pickup and switch off collision and physics while it waits in the pool
+	virtual void ParkInPool();
+
+	//Move the pickup into place and bring it back to life
+	virtual void UnparkFromPool(const FVector& location, const FRotator& rotation);
+
+	//Take on the mesh and values of a pickup type - server only, clients follow through replication
+	virtual void SetPickupType(class UPickupTypeAsset* pickupType);
+
+	FORCEINLINE class UPickupTypeAsset* GetPickupType() const { return m_pickupType; }
+
+	//Put the pickup's body to sleep and file it as settled
+	void Settle();
+
+	//Turn a frozen pickup back into a simulating one - for bumps, explosions and anything else that should move it
+	UFUNCTION(BlueprintCallable, Category = "Pickup")
+	void WakeFromFreeze();
+
+	//True while the pickup has been switched from simulating to static collision
+	FORCEINLINE bool IsFrozen() const { return m_bFrozen; }
+
+	//Stop replicating the pickup while its spawn volume is far from every player, and resume when one comes back
+	void SetUnwatched(bool bUnwatched);
+
+	//Client side - hide a pickup this client expects the server to collect, or show it again if the server refused
+	void SetPredictedCollected(bool bPredicted);
+	FORCEINLINE bool IsPredictedCollected() const { return m_bPredictedCollected; }
+
+	//Registry holding this pickup's state, null when the game mode doesn't keep one
+	class FPickupRegistry* GetRegistry() const;
+
+	FORCEINLINE int32 GetRegistrySlot() const { return m_registrySlot; }
+
 protected:
+	//Power the pickup gives when collected, copied into the registry when the pickup registers
+	virtual float GetPowerValue() const;
+
 	//True when pickup can be used and false when deactivated
+	UPROPERTY(Replicated)
 	bool bIsActive;
 
+	//Seconds a simulating pickup has to rest before its physics is switched off, negative to keep simulating
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Pickup|Physics", meta = (BlueprintProtected = "true"))
+	float freezeDelay;
+
 private:
 	//Static mesh to represent the pickup in the level
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Pickup", meta = (AllowPrivateAccess = "true"))
 	UStaticMeshComponent* m_PickupMesh;
 
+	//Pool that owns this pickup, null for pickups placed in the level
+	UPROPERTY()
+	class UPickupPool* m_owningPool;
+
+	//Whether the mesh was simulating physics before it was parked
+	bool m_bParkedSimulatingPhysics;
+
+	//Slot in the game mode's pickup registry, INDEX_NONE while not registered
+	int32 m_registrySlot;
+
+	//Physics was switched off after the pickup came to rest
+	bool m_bFrozen;
+
+	//Hidden on this client ahead of the server collecting it
+	bool m_bPredictedCollected;
+
+	//Type this pickup was spawned as, null for pickups placed in the level
+	UPROPERTY(ReplicatedUsing = OnRep_PickupType)
+	class UPickupTypeAsset* m_pickupType;
+
+	UFUNCTION()
+	void OnRep_PickupType();
+
+	//Switch to the type's mesh once it is loaded
+	void ApplyPickupTypeMesh();
+
+	//Bumped every time the pool hands the pickup out, so clients know a predicted collect is over
+	UPROPERTY(ReplicatedUsing = OnRep_PoolGeneration)
+	uint8 m_poolGeneration;
+
+	UFUNCTION()
+	void OnRep_PoolGeneration();
+
+	FTimerHandle m_freezeTimer;
+
+	//Swap the resting body for static collision
+	void Freeze();
+
+	//Stop replicating a pickup that has come to rest, and start again before anything about it changes - server only
+	void GoDormant();
+	void WakeDormant();
+
+	//Add or remove the pickup from the game mode's pickup registry
+	void RegisterWithRegistry();
+	void UnregisterFromRegistry();
+	//Physics went to sleep or woke up - re-file the pickup in the registry
+	UFUNCTION()
+	void OnMeshSleep(UPrimitiveComponent* SleepingComponent, FName BoneName);
+	UFUNCTION()
+	void OnMeshWake(UPrimitiveComponent* WakingComponent, FName BoneName);
+	//Something ran into the frozen pickup
+	UFUNCTION()
+	void OnMeshHit(UPrimitiveComponent* HitComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit);
+
 };
 	
@@ -0,0 +1,184 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BatteryCollector.h"
+#include "PickupPool.h"
+#include "Pickup.h"
+#include "PickupTypeAsset.h"
+#include "BatteryCollectorStats.h"
+
+
+UPickupPool::UPickupPool() {
+
+	m_owner = nullptr;
+	m_pickupType = nullptr;
+	m_maxSize = 0;
+	m_reserved = 0;
+	m_growth = ePickupPoolGrowth::eGrow;
+
+}
+
+void UPickupPool::Initialize(AActor* owner, TSubclassOf<APickup> pickupClass, int32 prewarmSize, int32 maxSize, ePickupPoolGrowth growth, UPickupTypeAsset* pickupType) {
+
+	m_owner = owner;
+	m_pickupClass = pickupClass;
+	m_pickupType = pickupType;
+	m_maxSize = maxSize;
+	m_growth = growth;
+
+	//Never pre-warm past the cap
+	if(m_maxSize > 0) {
+		prewarmSize = FMath::Min(prewarmSize, m_maxSize);
+	}
+
+	m_freePickups.Reserve(prewarmSize);
+	for(int32 iPickup = 0; iPickup < prewarmSize; iPickup++) {
+		APickup* const pickup = SpawnPooledPickup();
+		if(pickup) {
+			m_freePickups.Add(pickup);
+		}
+	}
+
+}
+
+APickup* UPickupPool::Acquire(const FVector& location, const FRotator& rotation) {
+
+	APickup* pickup = nullptr;
+
+	//Free pickups up to the reserved count are spoken for
+	if(m_freePickups.Num() > m_reserved) {
+		pickup = m_freePickups.Pop(false);
+		m_stats.hits++;
+	} else {
+		m_stats.misses++;
+
+		const bool bAtCap = m_maxSize > 0 && m_stats.totalInstances >= m_maxSize;
+
+		//Entries GC has nulled can't be recycled
+		m_usedPickups.Remove(nullptr);
+
+		if(m_growth == ePickupPoolGrowth::eRecycleOldest && m_usedPickups.Num() > 0) {
+			//Deactivating the oldest pickup sends it back through Release onto the free list
+			m_usedPickups[0]->SetActive(false);
+			if(m_freePickups.Num() > m_reserved) {
+				pickup = m_freePickups.Pop(false);
+			}
+		} else if(m_growth != ePickupPoolGrowth::eFixed && !bAtCap) {
+			pickup = SpawnPooledPickup();
+		}
+	}
+
+	if(pickup == nullptr) {
+		return nullptr;
+	}
+
+	HandOut(pickup, location, rotation);
+
+	return pickup;
+
+}
+
+void UPickupPool::AddReservation() {
+
+	m_reserved++;
+	UpdateInUse();
+
+}
+
+APickup* UPickupPool::AcquireReserved(const FVector& location, const FRotator& rotation) {
+
+	if(m_reserved > 0) {
+		m_reserved--;
+	}
+
+	//The waiting actor may have been destroyed since, its place is still ours
+	APickup* const pickup = m_freePickups.Num() > 0 ? m_freePickups.Pop(false) : SpawnPooledPickup();
+	if(pickup == nullptr) {
+		UpdateInUse();
+		return nullptr;
+	}
+
+	HandOut(pickup, location, rotation);
+
+	return pickup;
+
+}
+
+void UPickupPool::CancelReservation() {
+
+	if(m_reserved > 0) {
+		m_reserved--;
+		UpdateInUse();
+	}
+
+}
+
+void UPickupPool::HandOut(APickup* pickup, const FVector& location, const FRotator& rotation) {
+
+	m_usedPickups.Add(pickup);
+	UpdateInUse();
+	BATTERY_INC_COUNTER_BY(PooledPickups, 1);
+
+	pickup->UnparkFromPool(location, rotation);
+
+}
+
+void UPickupPool::UpdateInUse() {
+
+	m_stats.inUse = m_usedPickups.Num() + m_reserved;
+	m_stats.peakInUse = FMath::Max(m_stats.peakInUse, m_stats.inUse);
+
+}
+
+void UPickupPool::Release(APickup* pickup) {
+
+	//Only pickups we handed out go back on the free list
+	if(pickup == nullptr || m_usedPickups.RemoveSingle(pickup) == 0) {
+		return;
+	}
+
+	pickup->ParkInPool();
+	m_freePickups.Add(pickup);
+	UpdateInUse();
+	BATTERY_DEC_COUNTER_BY(PooledPickups, 1);
+
+}
+
+void UPickupPool::Remove(APickup* pickup) {
+
+	if(m_usedPickups.RemoveSingle(pickup) > 0) {
+		UpdateInUse();
+		BATTERY_DEC_COUNTER_BY(PooledPickups, 1);
+	} else if(m_freePickups.RemoveSingle(pickup) == 0) {
+		return;
+	}
+
+	//Gone for good, so it no longer counts against the cap
+	m_stats.totalInstances--;
+
+}
+
+APickup* UPickupPool::SpawnPooledPickup() {
+
+	UWorld* const world = m_owner ? m_owner->GetWorld() : nullptr;
+	if(world == nullptr || m_pickupClass == NULL) {
+		return nullptr;
+	}
+
+	FActorSpawnParameters spawnParams;
+	spawnParams.Owner = m_owner;
+	spawnParams.Instigator = m_owner->Instigator;
+	spawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	APickup* const pickup = world->SpawnActor<APickup>(m_pickupClass, m_owner->GetActorLocation(), FRotator::ZeroRotator, spawnParams);
+	if(pickup) {
+		pickup->SetPool(this);
+		if(m_pickupType) {
+			pickup->SetPickupType(m_pickupType);
+		}
+		pickup->ParkInPool();
+		m_stats.totalInstances++;
+	}
+
+	return pickup;
+
+}
@@ -0,0 +1,130 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "UObject/NoExportTypes.h"
+#include "PickupPool.generated.h"
+
+//What the pool does when it is asked for a pickup and has none free
+UENUM(BlueprintType)
+enum class ePickupPoolGrowth : uint8 {
+	//Never spawn past the pre-warmed size, the spawn is skipped
+	eFixed,
+	//Spawn a new pickup and keep it in the pool afterwards (up to the max size)
+	eGrow,
+	//Take the oldest pickup still in the level and reuse it
+	eRecycleOldest
+};
+
+//Usage counters for a pickup pool
+USTRUCT(BlueprintType)
+struct FPickupPoolStats {
+	GENERATED_BODY()
+
+	//Acquires served from the free list
+	UPROPERTY(BlueprintReadOnly, Category = "Pool")
+	int32 hits;
+
+	//Acquires that had to spawn, recycle or fail
+	UPROPERTY(BlueprintReadOnly, Category = "Pool")
+	int32 misses;
+
+	//Pickups currently out of the pool, and batteries drawn as instances while their actor waits in it
+	UPROPERTY(BlueprintReadOnly, Category = "Pool")
+	int32 inUse;
+
+	//Highest number of pickups out of the pool at once
+	UPROPERTY(BlueprintReadOnly, Category = "Pool")
+	int32 peakInUse;
+
+	//Every pickup owned by the pool, free or in use
+	UPROPERTY(BlueprintReadOnly, Category = "Pool")
+	int32 totalInstances;
+
+	FPickupPoolStats() : hits(0), misses(0), inUse(0), peakInUse(0), totalInstances(0) {}
+};
+
+/**
+ * Keeps a set of pickups of one class alive and hands them out instead of spawning and destroying actors.
+ * Free pickups are hidden, have no collision and do not simulate physics.
+ */
+UCLASS()
+class BATTERYCOLLECTOR_API UPickupPool : public UObject {
+	GENERATED_BODY()
+
+public:
+	UPickupPool();
+
+	/**
+	 * Set up the pool and spawn the pre-warmed pickups
+	 * @param owner	Actor used as the owner and spawn location of the pooled pickups
+	 * @param maxSize	Upper bound on instances owned by the pool, 0 means unbounded
+	 * @param pickupType	Type every pickup takes on as it is spawned, null to leave them as the class makes them
+	 */
+	void Initialize(AActor* owner, TSubclassOf<class APickup> pickupClass, int32 prewarmSize, int32 maxSize, ePickupPoolGrowth growth, class UPickupTypeAsset* pickupType = nullptr);
+
+	//Take a pickup out of the pool, move it into place and activate it. Returns null if the growth policy refuses
+	class APickup* Acquire(const FVector& location, const FRotator& rotation);
+
+	//Give a pickup back to the pool - called by APickup::SetActive(false)
+	void Release(class APickup* pickup);
+
+	//Forget a pickup destroyed outside the pool - called by APickup::EndPlay
+	void Remove(class APickup* pickup);
+
+	/**
+	 * Keep a place for a battery drawn as an instance (see ABatteryInstanceField). Its actor comes back to the free list
+	 * but still counts as in use, so instances can't take the pool past its cap
+	 */
+	void AddReservation();
+
+	//Take an actor out for a reserved place. Never refused, the place was counted when it was reserved
+	class APickup* AcquireReserved(const FVector& location, const FRotator& rotation);
+
+	//Give up a reserved place without taking an actor out
+	void CancelReservation();
+
+	//Class of pickup this pool hands out
+	FORCEINLINE TSubclassOf<class APickup> GetPickupClass() const { return m_pickupClass; }
+
+	FORCEINLINE const FPickupPoolStats& GetStats() const { return m_stats; }
+
+	//Pickups handed out and still in the level, oldest first
+	FORCEINLINE const TArray<class APickup*>& GetPickupsInUse() const { return m_usedPickups; }
+
+private:
+	//Spawn a new pickup owned by the pool and park it
+	class APickup* SpawnPooledPickup();
+
+	//Put a pickup taken off the free list into the level
+	void HandOut(class APickup* pickup, const FVector& location, const FRotator& rotation);
+
+	void UpdateInUse();
+
+	UPROPERTY()
+	AActor* m_owner;
+
+	UPROPERTY()
+	TSubclassOf<class APickup> m_pickupClass;
+
+	UPROPERTY()
+	class UPickupTypeAsset* m_pickupType;
+
+	//Pickups ready to be handed out
+	UPROPERTY()
+	TArray<class APickup*> m_freePickups;
+
+	//Pickups in the level, oldest first
+	UPROPERTY()
+	TArray<class APickup*> m_usedPickups;
+
+	int32 m_maxSize;
+
+	//Free pickups held back for instanced batteries
+	int32 m_reserved;
+
+	ePickupPoolGrowth m_growth;
+
+	FPickupPoolStats m_stats;
+
+};
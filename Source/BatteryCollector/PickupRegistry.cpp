@@ -0,0 +1,205 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BatteryCollector.h"
+#include "PickupRegistry.h"
+#include "Pickup.h"
+#include "BatteryCollectorStats.h"
+
+
+FPickupRegistry::FPickupRegistry() {
+
+	m_maxRadius = 0.0f;
+
+}
+
+void FPickupRegistry::SetCellSize(float cellSize) {
+
+	m_hash.SetCellSize(cellSize);
+
+}
+
+int32 FPickupRegistry::Register(APickup* proxy, uint8 typeId, float power, bool bActive, bool bSettled) {
+
+	check(proxy);
+
+	int32 slot;
+	if(m_freeSlots.Num() > 0) {
+		slot = m_freeSlots.Pop(false);
+	} else {
+		slot = m_proxies.Num();
+		m_positionX.AddUninitialized();
+		m_positionY.AddUninitialized();
+		m_positionZ.AddUninitialized();
+		m_radius.AddUninitialized();
+		m_active.AddUninitialized();
+		m_settled.AddUninitialized();
+		m_power.AddUninitialized();
+		m_typeId.AddUninitialized();
+		m_proxies.AddUninitialized();
+	}
+
+	m_proxies[slot] = proxy;
+	m_active[slot] = bActive ? 1 : 0;
+	m_power[slot] = power;
+	m_typeId[slot] = typeId;
+	m_settled[slot] = bSettled ? 1 : 0;
+	ReadProxyTransform(slot);
+
+	if(bSettled) {
+		m_hash.Add(slot, GetPosition(slot));
+	} else {
+		m_movingSlots.Add(slot);
+	}
+
+	BATTERY_INC_COUNTER_BY(LivePickups, 1);
+
+	return slot;
+
+}
+
+void FPickupRegistry::Unregister(int32 slot) {
+
+	if(m_movingSlots.RemoveSingleSwap(slot, false) == 0) {
+		m_hash.Remove(slot);
+	}
+
+	//A free slot must be invisible to batch loops
+	m_proxies[slot] = nullptr;
+	m_active[slot] = 0;
+	m_settled[slot] = 0;
+	m_power[slot] = 0.0f;
+	m_freeSlots.Add(slot);
+
+	BATTERY_DEC_COUNTER_BY(LivePickups, 1);
+
+}
+
+void FPickupRegistry::SetSettled(int32 slot, bool bSettled) {
+
+	if(m_movingSlots.RemoveSingleSwap(slot, false) == 0) {
+		m_hash.Remove(slot);
+	}
+
+	m_settled[slot] = bSettled ? 1 : 0;
+	ReadProxyTransform(slot);
+
+	if(bSettled) {
+		m_hash.Add(slot, GetPosition(slot));
+	} else {
+		m_movingSlots.Add(slot);
+	}
+
+}
+
+uint8 FPickupRegistry::FindOrAddTypeId(const UObject* typeKey) {
+
+	int32 typeId = m_typeKeys.Find(typeKey);
+	if(typeId == INDEX_NONE) {
+		typeId = m_typeKeys.Add(typeKey);
+	}
+
+	check(typeId <= MAX_uint8);
+	return (uint8)typeId;
+
+}
+
+void FPickupRegistry::QueryRadius(const FVector& center, float radius, TArray<int32>& outSlots) {
+
+	RefreshMovingPositions();
+
+	m_candidates.Reset();
+	m_candidates.Append(m_movingSlots);
+	m_hash.GatherCandidates(center, radius + m_maxRadius, m_candidates);
+
+	for(const int32 slot : m_candidates) {
+		const float dx = m_positionX[slot] - center.X;
+		const float dy = m_positionY[slot] - center.Y;
+		const float dz = m_positionZ[slot] - center.Z;
+		const float reach = radius + m_radius[slot];
+
+		if(m_active[slot] && dx * dx + dy * dy + dz * dz <= reach * reach) {
+			outSlots.Add(slot);
+		}
+	}
+
+}
+
+void FPickupRegistry::GatherSettledBeyond(const TArray<FVector>& points, float distance, TArray<int32>& outSlots) const {
+
+	const int32 slotCount = m_proxies.Num();
+	const float distanceSquared = distance * distance;
+
+	for(int32 slot = 0; slot < slotCount; slot++) {
+		if(!(m_active[slot] & m_settled[slot])) {
+			continue;
+		}
+
+		bool bFar = true;
+		for(const FVector& point : points) {
+			const float dx = m_positionX[slot] - point.X;
+			const float dy = m_positionY[slot] - point.Y;
+			const float dz = m_positionZ[slot] - point.Z;
+			if(dx * dx + dy * dy + dz * dz <= distanceSquared) {
+				bFar = false;
+				break;
+			}
+		}
+
+		if(bFar) {
+			outSlots.Add(slot);
+		}
+	}
+
+}
+
+int32 FPickupRegistry::CountActive() const {
+
+	const int32 slotCount = m_active.Num();
+	const uint8* const active = m_active.GetData();
+
+	int32 activeCount = 0;
+	for(int32 slot = 0; slot < slotCount; slot++) {
+		activeCount += active[slot];
+	}
+
+	return activeCount;
+
+}
+
+void FPickupRegistry::GatherActive(TArray<int32>& outSlots, TArray<FVector>& outPositions, TArray<float>& outPower) {
+
+	RefreshMovingPositions();
+
+	const int32 slotCount = m_proxies.Num();
+	for(int32 slot = 0; slot < slotCount; slot++) {
+		if(m_active[slot]) {
+			outSlots.Add(slot);
+			outPositions.Add(FVector(m_positionX[slot], m_positionY[slot], m_positionZ[slot]));
+			outPower.Add(m_power[slot]);
+		}
+	}
+
+}
+
+void FPickupRegistry::RefreshMovingPositions() {
+
+	for(const int32 slot : m_movingSlots) {
+		const FVector location = m_proxies[slot]->GetActorLocation();
+		m_positionX[slot] = location.X;
+		m_positionY[slot] = location.Y;
+		m_positionZ[slot] = location.Z;
+	}
+
+}
+
+void FPickupRegistry::ReadProxyTransform(int32 slot) {
+
+	APickup* const proxy = m_proxies[slot];
+	const FVector location = proxy->GetActorLocation();
+	m_positionX[slot] = location.X;
+	m_positionY[slot] = location.Y;
+	m_positionZ[slot] = location.Z;
+	m_radius[slot] = proxy->GetMesh()->Bounds.SphereRadius;
+	m_maxRadius = FMath::Max(m_maxRadius, m_radius[slot]);
+
+}
@@ -0,0 +1,108 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "PickupSpatialHash.h"
+
+/**
+ * World-level store of pickup state in structure-of-arrays form.
+ * Each pickup in the level owns a slot, the actor is only a render/physics proxy for it.
+ * Slots are stable for the pickup's lifetime and reused through a free list, freed slots are inactive with no power
+ * so batch operations can run straight over the arrays without branching on slot validity.
+ */
+class BATTERYCOLLECTOR_API FPickupRegistry {
+
+public:
+	FPickupRegistry();
+
+	//Change the cell size of the spatial index - only valid while the registry is empty
+	void SetCellSize(float cellSize);
+
+	/**
+	 * Give a pickup a slot
+	 * @param bSettled	False while physics is still moving the pickup
+	 * @return	The slot, to be handed back to Unregister
+	 */
+	int32 Register(class APickup* proxy, uint8 typeId, float power, bool bActive, bool bSettled);
+
+	//Free a pickup's slot
+	void Unregister(int32 slot);
+
+	//Physics settled or woke up the pickup - re-read its position and re-file it
+	void SetSettled(int32 slot, bool bSettled);
+
+	FORCEINLINE bool IsActive(int32 slot) const { return m_active[slot] != 0; }
+	FORCEINLINE void SetActive(int32 slot, bool bActive) { m_active[slot] = bActive ? 1 : 0; }
+
+	FORCEINLINE float GetPower(int32 slot) const { return m_power[slot]; }
+	FORCEINLINE void SetPower(int32 slot, float power) { m_power[slot] = power; }
+
+	FORCEINLINE bool IsSettled(int32 slot) const { return m_settled[slot] != 0; }
+
+	FORCEINLINE uint8 GetTypeId(int32 slot) const { return m_typeId[slot]; }
+	FORCEINLINE FVector GetPosition(int32 slot) const { return FVector(m_positionX[slot], m_positionY[slot], m_positionZ[slot]); }
+	FORCEINLINE class APickup* GetProxy(int32 slot) const { return m_proxies[slot]; }
+
+	//Small id for a kind of pickup (a class or type asset), shared by every pickup of that kind
+	uint8 FindOrAddTypeId(const UObject* typeKey);
+
+	//Append the slots of active pickups whose bounds reach into the sphere
+	void QueryRadius(const FVector& center, float radius, TArray<int32>& outSlots);
+
+	//Append the slots of settled, active pickups farther than distance from every point
+	void GatherSettledBeyond(const TArray<FVector>& points, float distance, TArray<int32>& outSlots) const;
+
+	//Append the slot, position and power of every active pickup, for copies read off the game thread
+	void GatherActive(TArray<int32>& outSlots, TArray<FVector>& outPositions, TArray<float>& outPower);
+
+	//Number of active pickups
+	int32 CountActive() const;
+
+	//Pickups holding a slot
+	FORCEINLINE int32 Num() const { return m_proxies.Num() - m_freeSlots.Num(); }
+
+	//Slots in the arrays including free ones, the upper bound for slot indices
+	FORCEINLINE int32 GetSlotCount() const { return m_proxies.Num(); }
+
+private:
+	//Copy the live location of moving pickups into the position arrays
+	void RefreshMovingPositions();
+
+	//Read position and bounds from the proxy
+	void ReadProxyTransform(int32 slot);
+
+	//Position, split per axis so batch loops stay contiguous
+	TArray<float> m_positionX;
+	TArray<float> m_positionY;
+	TArray<float> m_positionZ;
+
+	//Bounding sphere radius of each pickup
+	TArray<float> m_radius;
+
+	TArray<uint8> m_active;
+
+	//Non-zero once physics has let the pickup come to rest
+	TArray<uint8> m_settled;
+
+	TArray<float> m_power;
+
+	TArray<uint8> m_typeId;
+
+	TArray<class APickup*> m_proxies;
+
+	TArray<int32> m_freeSlots;
+
+	//Slots still simulating, kept out of the spatial hash until they settle
+	TArray<int32> m_movingSlots;
+
+	//Largest pickup bounds seen, widens the cell range of a query
+	float m_maxRadius;
+
+	FPickupSpatialHash m_hash;
+
+	TArray<const UObject*> m_typeKeys;
+
+	//Scratch list reused between queries
+	TArray<int32> m_candidates;
+
+};
@@ -0,0 +1,68 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BatteryCollector.h"
+#include "PickupSpatialHash.h"
+
+
+FPickupSpatialHash::FPickupSpatialHash(float cellSize) {
+
+	m_cellSize = FMath::Max(cellSize, 1.0f);
+
+}
+
+void FPickupSpatialHash::SetCellSize(float cellSize) {
+
+	check(Num() == 0);
+	m_cellSize = FMath::Max(cellSize, 1.0f);
+
+}
+
+void FPickupSpatialHash::Add(int32 slot, const FVector& location) {
+
+	const FIntVector cell = GetCell(location);
+	m_cells.FindOrAdd(cell).Add(slot);
+	m_slotCells.Add(slot, cell);
+
+}
+
+void FPickupSpatialHash::Remove(int32 slot) {
+
+	FIntVector cell;
+	if(!m_slotCells.RemoveAndCopyValue(slot, cell)) {
+		return;
+	}
+
+	TArray<int32>* const slots = m_cells.Find(cell);
+	if(slots) {
+		slots->RemoveSingleSwap(slot, false);
+
+		if(slots->Num() == 0) {
+			m_cells.Remove(cell);
+		}
+	}
+
+}
+
+void FPickupSpatialHash::GatherCandidates(const FVector& center, float reach, TArray<int32>& outSlots) const {
+
+	const FIntVector minCell = GetCell(center - FVector(reach));
+	const FIntVector maxCell = GetCell(center + FVector(reach));
+
+	for(int32 x = minCell.X; x <= maxCell.X; x++) {
+		for(int32 y = minCell.Y; y <= maxCell.Y; y++) {
+			for(int32 z = minCell.Z; z <= maxCell.Z; z++) {
+				const TArray<int32>* const slots = m_cells.Find(FIntVector(x, y, z));
+				if(slots) {
+					outSlots.Append(*slots);
+				}
+			}
+		}
+	}
+
+}
+
+FIntVector FPickupSpatialHash::GetCell(const FVector& location) const {
+
+	return FIntVector(FMath::FloorToInt(location.X / m_cellSize), FMath::FloorToInt(location.Y / m_cellSize), FMath::FloorToInt(location.Z / m_cellSize));
+
+}
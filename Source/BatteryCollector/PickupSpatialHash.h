@@ -0,0 +1,41 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+/**
+ * Uniform grid of pickup registry slots keyed on cell coordinates.
+ * Only settled pickups are filed here, the registry keeps pickups still moving under physics in its own list.
+ */
+class BATTERYCOLLECTOR_API FPickupSpatialHash {
+
+public:
+	explicit FPickupSpatialHash(float cellSize = 400.0f);
+
+	//Change the cell size - only valid while the hash is empty
+	void SetCellSize(float cellSize);
+
+	//File a slot in the cell containing location
+	void Add(int32 slot, const FVector& location);
+
+	//Stop tracking a slot, safe to call for slots that aren't filed
+	void Remove(int32 slot);
+
+	//Append every slot filed in a cell the sphere can touch - callers still need to test the exact distance
+	void GatherCandidates(const FVector& center, float reach, TArray<int32>& outSlots) const;
+
+	//Number of slots filed
+	FORCEINLINE int32 Num() const { return m_slotCells.Num(); }
+
+	FORCEINLINE float GetCellSize() const { return m_cellSize; }
+
+private:
+	FIntVector GetCell(const FVector& location) const;
+
+	float m_cellSize;
+
+	TMap<FIntVector, TArray<int32>> m_cells;
+
+	//Cell of each filed slot
+	TMap<int32, FIntVector> m_slotCells;
+
+};
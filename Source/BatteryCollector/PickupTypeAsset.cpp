@@ -0,0 +1,41 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BatteryCollector.h"
+#include "PickupTypeAsset.h"
+#include "Pickup.h"
+
+
+UPickupTypeAsset::UPickupTypeAsset() {
+
+	power = 150.0f;
+	weight = 1.0f;
+
+}
+
+void UPickupTypeAsset::GetAssetsToLoad(TArray<FStringAssetReference>& outAssets) const {
+
+	//Unset references are null, loaded ones have nothing left to do
+	if(pickupClass.IsPending()) {
+		outAssets.AddUnique(pickupClass.ToStringReference());
+	}
+	if(mesh.IsPending()) {
+		outAssets.AddUnique(mesh.ToStringReference());
+	}
+	if(collectEffect.IsPending()) {
+		outAssets.AddUnique(collectEffect.ToStringReference());
+	}
+
+}
+
+bool UPickupTypeAsset::IsLoaded() const {
+
+	return pickupClass.Get() != nullptr && !mesh.IsPending() && !collectEffect.IsPending();
+
+}
+
+FStreamableManager& UPickupTypeAsset::GetStreamableManager() {
+
+	static FStreamableManager streamableManager;
+	return streamableManager;
+
+}
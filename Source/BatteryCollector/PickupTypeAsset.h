@@ -0,0 +1,50 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "Engine/DataAsset.h"
+#include "Engine/StreamableManager.h"
+#include "PickupTypeAsset.generated.h"
+
+/**
+ * One kind of pickup a spawn volume can drop. Everything heavy is a soft reference, so a map only pulls in the
+ * meshes and effects of the types its volumes use - and streams them in after it has loaded rather than with it.
+ * New types are new assets, no code or map changes needed.
+ */
+UCLASS(BlueprintType)
+class BATTERYCOLLECTOR_API UPickupTypeAsset : public UDataAsset {
+	GENERATED_BODY()
+
+public:
+	UPickupTypeAsset();
+
+	//Pickup class to spawn
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Pickup")
+	TAssetSubclassOf<class APickup> pickupClass;
+
+	//Mesh to use instead of the class's own, none keeps the class's
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Pickup")
+	TAssetPtr<class UStaticMesh> mesh;
+
+	//Played where the pickup is collected
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Pickup")
+	TAssetPtr<class UParticleSystem> collectEffect;
+
+	//Power a battery of this type gives
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Pickup", meta = (ClampMin = "0.0"))
+	float power;
+
+	//Relative chance a volume picks this type
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Pickup", meta = (ClampMin = "0.0"))
+	float weight;
+
+	//Append every soft reference that still needs loading
+	void GetAssetsToLoad(TArray<FStringAssetReference>& outAssets) const;
+
+	//True once the class and any mesh and effect are in memory
+	bool IsLoaded() const;
+
+	//Shared by everything streaming pickup assets - spawn volumes on the server, pickups on clients
+	static FStreamableManager& GetStreamableManager();
+
+};
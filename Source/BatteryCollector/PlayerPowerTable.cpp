@@ -0,0 +1,89 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BatteryCollector.h"
+#include "PlayerPowerTable.h"
+
+
+int32 FPlayerPowerTable::Add(ABatteryCollectorCharacter* character, float winThreshold) {
+
+	m_power.Add(0.0f);
+	m_timestamp.Add(0.0f);
+	m_decayRate.Add(0.0f);
+	m_winThreshold.Add(winThreshold);
+	m_state.Add((uint8)ePlayerPowerState::ePlaying);
+	return m_characters.Add(character);
+
+}
+
+void FPlayerPowerTable::RemoveAt(int32 index) {
+
+	m_power.RemoveAtSwap(index, 1, false);
+	m_timestamp.RemoveAtSwap(index, 1, false);
+	m_decayRate.RemoveAtSwap(index, 1, false);
+	m_winThreshold.RemoveAtSwap(index, 1, false);
+	m_state.RemoveAtSwap(index, 1, false);
+	m_characters.RemoveAtSwap(index, 1, false);
+
+}
+
+void FPlayerPowerTable::SetPower(int32 index, float power, float timestamp, float decayPerSecond) {
+
+	m_power[index] = power;
+	m_timestamp[index] = timestamp;
+	m_decayRate[index] = decayPerSecond;
+
+}
+
+float FPlayerPowerTable::GetNextDepletionTime() const {
+
+	const int32 count = m_characters.Num();
+	const float* const power = m_power.GetData();
+	const float* const timestamp = m_timestamp.GetData();
+	const float* const decayRate = m_decayRate.GetData();
+	const uint8* const state = m_state.GetData();
+
+	float earliest = MAX_flt;
+	for(int32 index = 0; index < count; index++) {
+		//Players not draining or out of the match select MAX_flt rather than branching
+		const bool bDraining = decayRate[index] > 0.0f && state[index] == (uint8)ePlayerPowerState::ePlaying;
+		const float depletionTime = bDraining ? BatteryPowerSim::DepletionTime(power[index], timestamp[index], decayRate[index]) : MAX_flt;
+		earliest = FMath::Min(earliest, depletionTime);
+	}
+
+	return earliest;
+
+}
+
+void FPlayerPowerTable::CollectDepleted(float now, TArray<int32>& outIndices) {
+
+	const int32 count = m_characters.Num();
+
+	for(int32 index = 0; index < count; index++) {
+		if(m_state[index] == (uint8)ePlayerPowerState::ePlaying && BatteryPowerSim::HasRunOut(GetPowerAt(index, now))) {
+			m_state[index] = (uint8)ePlayerPowerState::eLost;
+			outIndices.Add(index);
+		}
+	}
+
+}
+
+int32 FPlayerPowerTable::CountPlaying() const {
+
+	int32 playing = 0;
+	for(const uint8 state : m_state) {
+		playing += state == (uint8)ePlayerPowerState::ePlaying ? 1 : 0;
+	}
+	return playing;
+
+}
+
+void FPlayerPowerTable::Reset() {
+
+	m_power.Reset();
+	m_timestamp.Reset();
+	m_decayRate.Reset();
+	m_winThreshold.Reset();
+	m_state.Reset();
+	m_characters.Reset();
+
+}
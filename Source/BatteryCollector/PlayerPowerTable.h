@@ -0,0 +1,63 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "BatteryPowerSim.h"
+
+/**
+ * Power of every player in the match in structure-of-arrays form, kept by the game mode.
+ * Each row mirrors a character's lazily decaying power: the level at a timestamp and the rate it drains at. Because
+ * decay is linear the table never needs a per-frame update - one pass finds when the next player will run out, and
+ * one pass at that time picks out everyone who has.
+ */
+class BATTERYCOLLECTOR_API FPlayerPowerTable {
+
+public:
+	//Add a player, returns the row
+	int32 Add(class ABatteryCollectorCharacter* character, float winThreshold);
+
+	//Remove a player - the last row moves into its place
+	void RemoveAt(int32 index);
+
+	//Row of a character, INDEX_NONE if it isn't in the table
+	FORCEINLINE int32 IndexOf(const class ABatteryCollectorCharacter* character) const { return m_characters.IndexOfByKey(character); }
+
+	FORCEINLINE class ABatteryCollectorCharacter* GetCharacter(int32 index) const { return m_characters[index]; }
+
+	//Copy a player's power, as of the given time
+	void SetPower(int32 index, float power, float timestamp, float decayPerSecond);
+
+	FORCEINLINE float GetPowerAt(int32 index, float time) const { return BatteryPowerSim::PowerAt(m_power[index], m_timestamp[index], m_decayRate[index], time); }
+
+	FORCEINLINE ePlayerPowerState GetState(int32 index) const { return (ePlayerPowerState)m_state[index]; }
+	FORCEINLINE void SetState(int32 index, ePlayerPowerState state) { m_state[index] = (uint8)state; }
+
+	//True if the player is still playing and has more power than it needs to win
+	FORCEINLINE bool HasWon(int32 index, float time) const { return m_state[index] == (uint8)ePlayerPowerState::ePlaying && BatteryPowerSim::HasWon(GetPowerAt(index, time), m_winThreshold[index]); }
+
+	//Earliest time a playing player runs out of power, MAX_flt if nobody is draining
+	float GetNextDepletionTime() const;
+
+	//Mark every playing player whose power has run out by now as lost, and append their rows
+	void CollectDepleted(float now, TArray<int32>& outIndices);
+
+	//Players still playing
+	int32 CountPlaying() const;
+
+	FORCEINLINE int32 Num() const { return m_characters.Num(); }
+
+	void Reset();
+
+private:
+	//Power at m_timestamp, per player
+	TArray<float> m_power;
+	TArray<float> m_timestamp;
+	TArray<float> m_decayRate;
+	TArray<float> m_winThreshold;
+
+	//ePlayerPowerState
+	TArray<uint8> m_state;
+
+	TArray<class ABatteryCollectorCharacter*> m_characters;
+
+};
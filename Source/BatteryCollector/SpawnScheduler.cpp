@@ -0,0 +1,158 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "BatteryCollector.h"
+#include "SpawnScheduler.h"
+#include "SpawnVolume.h"
+
+
+FSpawnScheduler::FSpawnScheduler() {
+
+	m_nextTick = 0;
+	m_readyHead = 0;
+	m_nextGeneration = 0;
+	Initialize(0.1f, 64);
+
+}
+
+void FSpawnScheduler::Initialize(float slotSeconds, int32 slotCount) {
+
+	check(Num() == 0);
+
+	m_slotSeconds = FMath::Max(slotSeconds, KINDA_SMALL_NUMBER);
+	m_slots.Reset();
+	m_slots.SetNum(FMath::Max(slotCount, 1));
+
+}
+
+void FSpawnScheduler::Schedule(ASpawnVolume* volume, float dueTime) {
+
+	check(volume);
+
+	//Anything already scheduled for the volume goes stale
+	m_nextGeneration++;
+	m_generations.Add(volume, m_nextGeneration);
+
+	FEntry entry;
+	entry.volume = volume;
+	entry.dueTime = dueTime;
+	entry.tick = FMath::Max(GetTick(dueTime), m_nextTick);
+	entry.generation = m_nextGeneration;
+
+	m_slots[entry.tick % m_slots.Num()].Add(entry);
+
+}
+
+void FSpawnScheduler::Cancel(ASpawnVolume* volume) {
+
+	m_generations.Remove(volume);
+
+}
+
+void FSpawnScheduler::Clear() {
+
+	for(TArray<FEntry>& slot : m_slots) {
+		slot.Reset();
+	}
+
+	m_ready.Reset();
+	m_readyHead = 0;
+	m_generations.Reset();
+
+}
+
+void FSpawnScheduler::Advance(float now) {
+
+	const int64 nowTick = GetTick(now);
+	if(nowTick < m_nextTick) {
+		return;
+	}
+
+	//Drop what was popped off the front last frame
+	if(m_readyHead > 0) {
+		m_ready.RemoveAt(0, m_readyHead, false);
+		m_readyHead = 0;
+	}
+
+	const int32 firstNewReady = m_ready.Num();
+
+	//Past one full turn every slot has been looked at once
+	const int64 slotsToVisit = FMath::Min<int64>(nowTick - m_nextTick + 1, m_slots.Num());
+
+	for(int64 iSlot = 0; iSlot < slotsToVisit; iSlot++) {
+		TArray<FEntry>& slot = m_slots[(m_nextTick + iSlot) % m_slots.Num()];
+
+		for(int32 iEntry = slot.Num() - 1; iEntry >= 0; iEntry--) {
+			const FEntry& entry = slot[iEntry];
+			if(!IsLive(entry)) {
+				slot.RemoveAtSwap(iEntry, 1, false);
+			} else if(entry.dueTime <= now) {
+				m_ready.Add(entry);
+				slot.RemoveAtSwap(iEntry, 1, false);
+			}
+		}
+	}
+
+	//The current slot may still hold spawns due later in it, so it is looked at again next time
+	m_nextTick = nowTick;
+
+	//Earliest first, so a budgeted frame runs the most overdue spawns
+	if(m_ready.Num() - firstNewReady > 1) {
+		Sort(m_ready.GetData() + firstNewReady, m_ready.Num() - firstNewReady, [](const FEntry& a, const FEntry& b) {
+			return a.dueTime < b.dueTime;
+		});
+	}
+
+}
+
+ASpawnVolume* FSpawnScheduler::PopReady(float& outDueTime) {
+
+	while(m_readyHead < m_ready.Num()) {
+		const FEntry entry = m_ready[m_readyHead++];
+		if(IsLive(entry)) {
+			m_generations.Remove(entry.volume);
+			outDueTime = entry.dueTime;
+			return entry.volume;
+		}
+	}
+
+	//Drained - start the queue over rather than shifting it
+	m_ready.Reset();
+	m_readyHead = 0;
+
+	return nullptr;
+
+}
+
+bool FSpawnScheduler::FindDueTime(const ASpawnVolume* volume, float& outDueTime) const {
+
+	const uint32* const generation = m_generations.Find(volume);
+	if(generation == nullptr) {
+		return false;
+	}
+
+	for(int32 iReady = m_readyHead; iReady < m_ready.Num(); iReady++) {
+		if(m_ready[iReady].volume == volume && m_ready[iReady].generation == *generation) {
+			outDueTime = m_ready[iReady].dueTime;
+			return true;
+		}
+	}
+
+	for(const TArray<FEntry>& slot : m_slots) {
+		for(const FEntry& entry : slot) {
+			if(entry.volume == volume && entry.generation == *generation) {
+				outDueTime = entry.dueTime;
+				return true;
+			}
+		}
+	}
+
+	return false;
+
+}
+
+bool FSpawnScheduler::IsLive(const FEntry& entry) const {
+
+	const uint32* const generation = m_generations.Find(entry.volume);
+	return generation && *generation == entry.generation;
+
+}
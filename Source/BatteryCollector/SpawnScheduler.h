@@ -0,0 +1,100 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+//Spawn work done and put off by the scheduler since it was last reset
+struct FSpawnSchedulerStats {
+	//Due spawns that were run
+	int32 spawns;
+	//Due spawns carried to the next frame because the frame budget was used up, once per frame they wait
+	int32 deferredByBudget;
+	//Due spawns carried to the next frame because the level was at the live pickup cap, once per frame they wait
+	int32 deferredByCap;
+	//Most due spawns waiting at the end of a frame
+	int32 peakBacklog;
+	//Seconds between when spawns were due and when they ran
+	double totalLateness;
+	float maxLateness;
+
+	FSpawnSchedulerStats() : spawns(0), deferredByBudget(0), deferredByCap(0), peakBacklog(0), totalLateness(0.0), maxLateness(0.0f) {}
+};
+
+/**
+ * Hashed timing wheel holding the next spawn time of every spawn volume, so the level has one scheduler instead of a
+ * timer per volume.
+ *
+ * Due times are rounded down to a slot; entries more than one turn of the wheel ahead wait in their slot until their
+ * turn comes round. Advance moves everything due into a ready queue ordered by due time, which the owner drains under
+ * its own budget. Rescheduling or cancelling a volume just retires its old entry, stale entries are skipped when they
+ * come up.
+ */
+class BATTERYCOLLECTOR_API FSpawnScheduler {
+
+public:
+	FSpawnScheduler();
+
+	//Slot length in seconds and number of slots - only valid while nothing is scheduled
+	void Initialize(float slotSeconds, int32 slotCount);
+
+	//Spawn from the volume at the given time, replacing anything already scheduled for it
+	void Schedule(class ASpawnVolume* volume, float dueTime);
+
+	//Forget the volume's pending spawn
+	void Cancel(class ASpawnVolume* volume);
+
+	//Forget every pending spawn
+	void Clear();
+
+	//Move every spawn due by now onto the ready queue
+	void Advance(float now);
+
+	//Due spawns waiting to run, earliest first
+	FORCEINLINE int32 GetReadyCount() const { return m_ready.Num() - m_readyHead; }
+
+	/**
+	 * Take the earliest due spawn off the ready queue
+	 * @param outDueTime	When it was due
+	 * @return	The volume, or nullptr when nothing is ready
+	 */
+	class ASpawnVolume* PopReady(float& outDueTime);
+
+	//Volumes with a pending spawn
+	FORCEINLINE int32 Num() const { return m_generations.Num(); }
+
+	//When the volume's pending spawn is due, false if it has none. Looks through every entry, so keep it off hot paths
+	bool FindDueTime(const class ASpawnVolume* volume, float& outDueTime) const;
+
+	FORCEINLINE FSpawnSchedulerStats& GetStats() { return m_stats; }
+	FORCEINLINE const FSpawnSchedulerStats& GetStats() const { return m_stats; }
+
+private:
+	struct FEntry {
+		class ASpawnVolume* volume;
+		float dueTime;
+		//Wheel tick the entry fires on
+		int64 tick;
+		//Matches the volume's current generation while the entry is live
+		uint32 generation;
+	};
+
+	FORCEINLINE int64 GetTick(float time) const { return (int64)FMath::FloorToDouble(time / m_slotSeconds); }
+
+	bool IsLive(const FEntry& entry) const;
+
+	float m_slotSeconds;
+
+	TArray<TArray<FEntry>> m_slots;
+
+	//First tick that hasn't been advanced past
+	int64 m_nextTick;
+
+	TArray<FEntry> m_ready;
+	int32 m_readyHead;
+
+	//Current generation of each scheduled volume
+	TMap<class ASpawnVolume*, uint32> m_generations;
+	uint32 m_nextGeneration;
+
+	FSpawnSchedulerStats m_stats;
+
+};
@@ -2,15 +2,22 @@
 
 #include "BatteryCollector.h"
 #include "SpawnVolume.h"
-#include "Kismet/KismetMathLibrary.h"
+#include "InputRecording.h"
 #include "Pickup.h"
+#include "BatteryCollectorGameMode.h"
+#include "BatteryCollectorStats.h"
+#include "BatteryEventLog.h"
+#include "SpawnScheduler.h"
+#include "PickupTypeAsset.h"
 
 
 // Sets default values
 ASpawnVolume::ASpawnVolume()
 {
  	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = false;
+	//Only ticks while the spawn point cache has queries to send
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
 
 	//Create default box component
 	m_whereToSpawn = CreateDefaultSubobject<UBoxComponent>(TEXT("WhereToSpawn"));
@@ -20,13 +27,82 @@ ASpawnVolume::ASpawnVolume()
 	spawnDelayMin = 1.0f;
 	spawnDelayMax = 4.5f;
 
+	randomSeed = 0;
+
+	throttledDelayScale = 4.0f;
+	m_bSpawningActive = false;
+	m_pausedSpawnDelay = -1.0f;
+	m_significance = eSpawnSignificance::eFull;
+
+	//Pool defaults
+	poolSize = 16;
+	poolMaxSize = 0;
+	poolGrowth = ePickupPoolGrowth::eGrow;
+	m_pickupPool = nullptr;
+	m_typeLoadStart = 0.0;
+	m_bLoadingPickupTypes = false;
+
+	//Spawn point cache defaults
+	spawnPointCacheSize = 32;
+	spawnPointClearance = 0.0f;
+	spawnPointQueriesPerFrame = 8;
+	spawnPointRefreshInterval = 5.0f;
+	spawnPointsPerRefresh = 4;
+	m_spawnPointQueriesInFlight = 0;
+	m_spawnPointRadius = 0.0f;
+	m_spawnPointChannel = ECC_PhysicsBody;
+	m_spawnPointBuildStart = 0.0;
+
 }
 
 // Called when the game starts or when spawned
 void ASpawnVolume::BeginPlay()
 {
 	Super::BeginPlay();
-	
+
+	//Seed the stream - a session seed is mixed with the volume's name so volumes don't repeat each other
+	int32 sessionSeed = 0;
+	if(randomSeed != 0) {
+		m_randomStream.Initialize(randomSeed);
+	} else if(FInputRecording::GetSessionSeed(sessionSeed)) {
+		m_randomStream.Initialize((int32)HashCombine(GetTypeHash(sessionSeed), GetTypeHash(GetName())));
+	} else {
+		m_randomStream.GenerateNewSeed();
+	}
+	m_spawnPointStream.Initialize((int32)HashCombine(GetTypeHash(m_randomStream.GetInitialSeed()), GetTypeHash(TEXT("SpawnPoints"))));
+
+	//Only the server spawns, so only it needs pickup types loaded or a pool of pickups up front. Pickup types stream
+	//in after the map has loaded
+	if(GetNetMode() != NM_Client) {
+		if(pickupTypes.Num() > 0) {
+			BeginLoadingPickupTypes();
+		} else if(whatToSpawn != NULL) {
+			//Pre-warm the pool so spawning doesn't allocate actors during play
+			m_pickupPool = NewObject<UPickupPool>(this);
+			m_pickupPool->Initialize(this, whatToSpawn, poolSize, poolMaxSize, poolGrowth);
+			BeginSpawnPointCache(whatToSpawn, nullptr);
+		}
+	}
+
+	//The game mode spawns from every volume that registers, only servers have one
+	ABatteryCollectorGameMode* const gameMode = GetWorld()->GetAuthGameMode<ABatteryCollectorGameMode>();
+	if(gameMode) {
+		gameMode->RegisterSpawnVolume(this);
+	}
+
+}
+
+void ASpawnVolume::EndPlay(const EEndPlayReason::Type EndPlayReason) {
+
+	SetSpawningActive(false);
+
+	ABatteryCollectorGameMode* const gameMode = GetWorld()->GetAuthGameMode<ABatteryCollectorGameMode>();
+	if(gameMode) {
+		gameMode->UnregisterSpawnVolume(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+
 }
 
 // Called every frame
@@ -34,62 +110,442 @@ void ASpawnVolume::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
+	FCollisionQueryParams queryParams(FName(TEXT("SpawnPoint")), false, this);
+	const FCollisionShape sphere = FCollisionShape::MakeSphere(m_spawnPointRadius);
+
+	//Top up the cache, re-checks first so known points come back quickly
+	while(m_spawnPointQueriesInFlight < spawnPointQueriesPerFrame) {
+		FVector point;
+		if(m_spawnPointsToRecheck.Num() > 0) {
+			point = m_spawnPointsToRecheck.Pop(false);
+		} else if(m_spawnPoints.Num() + m_spawnPointQueriesInFlight < spawnPointCacheSize) {
+			point = GetRandomPointFromStream(m_spawnPointStream);
+		} else {
+			break;
+		}
+
+		GetWorld()->AsyncOverlapByObjectType(point, FQuat::Identity, FCollisionObjectQueryParams::AllObjects, sphere, queryParams, &m_spawnPointOverlapDelegate);
+		m_spawnPointQueriesInFlight++;
+	}
+
+	UpdateSpawnPointTick();
+
+}
+
+void ASpawnVolume::BeginLoadingPickupTypes() {
+
+	m_typePools.SetNumZeroed(pickupTypes.Num());
+	m_typeLoadStart = FPlatformTime::Seconds();
+	m_bLoadingPickupTypes = true;
+
+	TArray<FStringAssetReference> assetsToLoad;
+	for(const UPickupTypeAsset* const pickupType : pickupTypes) {
+		if(pickupType) {
+			pickupType->GetAssetsToLoad(assetsToLoad);
+		}
+	}
+
+	//Another volume may have loaded the same types already
+	if(assetsToLoad.Num() == 0) {
+		OnPickupTypesLoaded();
+		return;
+	}
+
+	UPickupTypeAsset::GetStreamableManager().RequestAsyncLoad(assetsToLoad, FStreamableDelegate::CreateUObject(this, &ASpawnVolume::OnPickupTypesLoaded));
+
+}
+
+void ASpawnVolume::OnPickupTypesLoaded() {
+
+	m_bLoadingPickupTypes = false;
+
+	float totalWeight = 0.0f;
+	for(const UPickupTypeAsset* const pickupType : pickupTypes) {
+		totalWeight += pickupType ? pickupType->weight : 0.0f;
+	}
+
+	int32 loadedTypes = 0;
+	for(int32 iType = 0; iType < pickupTypes.Num(); iType++) {
+		UPickupTypeAsset* const pickupType = pickupTypes[iType];
+		if(pickupType == nullptr || pickupType->weight <= 0.0f || !pickupType->IsLoaded() || m_typePools[iType] != nullptr) {
+			continue;
+		}
+
+		TSubclassOf<APickup> pickupClass = pickupType->pickupClass.Get();
+		m_loadedTypeAssets.Add(pickupClass);
+		m_loadedTypeAssets.Add(pickupType->mesh.Get());
+		m_loadedTypeAssets.Add(pickupType->collectEffect.Get());
+
+		//The pre-warmed pickups are shared out by weight
+		const int32 prewarmSize = FMath::CeilToInt(poolSize * pickupType->weight / totalWeight);
+		m_typePools[iType] = NewObject<UPickupPool>(this);
+		m_typePools[iType]->Initialize(this, pickupClass, prewarmSize, poolMaxSize, poolGrowth, pickupType);
+
+		//Clearance comes from the first type to load
+		if(loadedTypes == 0) {
+			BeginSpawnPointCache(pickupClass, pickupType->mesh.Get());
+		}
+		loadedTypes++;
+	}
+
+	UE_LOG(LogClass, Log, TEXT("%s streamed in %d of %d pickup types in %.3f s"), *GetName(), loadedTypes, pickupTypes.Num(), FPlatformTime::Seconds() - m_typeLoadStart);
+
+}
+
+UPickupPool* ASpawnVolume::ChoosePool() {
+
+	if(pickupTypes.Num() == 0) {
+		return m_pickupPool;
+	}
+
+	//Weighted choice over the types that have loaded
+	float totalWeight = 0.0f;
+	for(int32 iType = 0; iType < m_typePools.Num(); iType++) {
+		totalWeight += m_typePools[iType] ? pickupTypes[iType]->weight : 0.0f;
+	}
+	if(totalWeight <= 0.0f) {
+		return nullptr;
+	}
+
+	float choice = m_randomStream.FRand() * totalWeight;
+	UPickupPool* chosenPool = nullptr;
+	for(int32 iType = 0; iType < m_typePools.Num(); iType++) {
+		if(m_typePools[iType]) {
+			chosenPool = m_typePools[iType];
+			choice -= pickupTypes[iType]->weight;
+			if(choice < 0.0f) {
+				break;
+			}
+		}
+	}
+	return chosenPool;
+
+}
+
+void ASpawnVolume::BeginSpawnPointCache(TSubclassOf<APickup> pickupClass, UStaticMesh* meshOverride) {
+
+	//Only the server spawns, clients never draw from the cache
+	if(spawnPointCacheSize <= 0 || pickupClass == NULL || GetNetMode() == NM_Client) {
+		return;
+	}
+
+	//Clear space for the whole pickup, whichever way up it spawns
+	const APickup* const pickupDefaults = pickupClass->GetDefaultObject<APickup>();
+	UStaticMeshComponent* const pickupMesh = pickupDefaults->GetMesh();
+	UStaticMesh* const staticMesh = meshOverride ? meshOverride : pickupMesh->GetStaticMesh();
+	m_spawnPointChannel = pickupMesh->GetCollisionObjectType();
+	m_spawnPointRadius = spawnPointClearance;
+	if(m_spawnPointRadius <= 0.0f && staticMesh) {
+		m_spawnPointRadius = staticMesh->GetBounds().SphereRadius * pickupMesh->RelativeScale3D.GetMax();
+	}
+	if(m_spawnPointRadius <= 0.0f) {
+		m_spawnPointRadius = 50.0f;
+	}
+
+	m_spawnPoints.Reserve(spawnPointCacheSize);
+	m_spawnPointOverlapDelegate.BindUObject(this, &ASpawnVolume::OnSpawnPointOverlap);
+	m_spawnPointBuildStart = FPlatformTime::Seconds();
+	UpdateSpawnPointTick();
+
+	if(spawnPointRefreshInterval > 0.0f) {
+		GetWorldTimerManager().SetTimer(m_spawnPointRefreshTimer, this, &ASpawnVolume::RecheckSpawnPoints, spawnPointRefreshInterval, true);
+	}
+
+}
+
+void ASpawnVolume::UpdateSpawnPointTick() {
+
+	const bool bNeedsQueries = m_spawnPointsToRecheck.Num() > 0 || m_spawnPoints.Num() + m_spawnPointQueriesInFlight < spawnPointCacheSize;
+	SetActorTickEnabled(spawnPointCacheSize > 0 && m_spawnPointRadius > 0.0f && bNeedsQueries);
+
+}
+
+void ASpawnVolume::OnSpawnPointOverlap(const FTraceHandle& handle, FOverlapDatum& datum) {
+
+	m_spawnPointQueriesInFlight--;
+	m_spawnPointStats.tested++;
+
+	//Only geometry the pickup would be pushed out of counts - other pickups, pawns and triggers don't
+	bool bBlocked = false;
+	for(const FOverlapResult& overlap : datum.OutOverlaps) {
+		UPrimitiveComponent* const component = overlap.GetComponent();
+		if(component && !Cast<APickup>(overlap.GetActor()) && !Cast<APawn>(overlap.GetActor()) &&
+			component->GetCollisionResponseToChannel(m_spawnPointChannel) == ECR_Block) {
+			bBlocked = true;
+			break;
+		}
+	}
+
+	if(bBlocked) {
+		m_spawnPointStats.rejected++;
+	} else if(m_spawnPoints.Num() < spawnPointCacheSize) {
+		m_spawnPoints.Add(datum.Pos);
+		if(m_spawnPointStats.buildSeconds == 0.0f && m_spawnPoints.Num() == spawnPointCacheSize) {
+			m_spawnPointStats.buildSeconds = (float)(FPlatformTime::Seconds() - m_spawnPointBuildStart);
+		}
+	}
+
+	UpdateSpawnPointTick();
+
+}
+
+void ASpawnVolume::RecheckSpawnPoints() {
+
+	//A few of the longest unchecked points at a time, so moved geometry is noticed without re-testing the whole cache at
+	//once. The ones still clear go on the back, so the whole cache comes round in turn
+	const int32 recheckCount = FMath::Min(FMath::Max(spawnPointsPerRefresh, 0), m_spawnPoints.Num());
+	if(recheckCount > 0) {
+		m_spawnPointsToRecheck.Append(m_spawnPoints.GetData(), recheckCount);
+		m_spawnPoints.RemoveAt(0, recheckCount, false);
+	}
+
+	UpdateSpawnPointTick();
+
+}
+
+FVector ASpawnVolume::DrawSpawnPoint() {
+
+	if(m_spawnPoints.Num() == 0) {
+		if(spawnPointCacheSize > 0) {
+			m_spawnPointStats.fallbacks++;
+		}
+		return GetRandomPointFromStream(m_spawnPointStream);
+	}
+
+	//Cached points were random to begin with, so take the oldest. It is used up so two pickups don't land on the same spot
+	const FVector point = m_spawnPoints[0];
+	m_spawnPoints.RemoveAt(0, 1, false);
+	m_spawnPointStats.drawn++;
+
+	UpdateSpawnPointTick();
+
+	return point;
+
+}
+
+void ASpawnVolume::InvalidateSpawnPoints(FVector center, float radius) {
+
+	//Kept in order, the oldest points are the next to be used and rechecked
+	const float radiusSquared = FMath::Square(radius);
+	m_spawnPoints.RemoveAll([&](const FVector& point) {
+		return FVector::DistSquared(point, center) <= radiusSquared;
+	});
+
+	UpdateSpawnPointTick();
+
+}
+
+FSpawnPointCacheStats ASpawnVolume::GetSpawnPointStats() const {
+
+	FSpawnPointCacheStats stats = m_spawnPointStats;
+	stats.cached = m_spawnPoints.Num();
+	return stats;
+
 }
 
 FVector ASpawnVolume::GetRandomPointInVolume() {
 
+	return GetRandomPointFromStream(m_randomStream);
+
+}
+
+FVector ASpawnVolume::GetRandomPointFromStream(FRandomStream& stream) const {
+
 	FVector spawnOrigin = m_whereToSpawn->Bounds.Origin;
 	FVector spawnExtents = m_whereToSpawn->Bounds.BoxExtent;
 
-	return UKismetMathLibrary::RandomPointInBoundingBox(spawnOrigin, spawnExtents);
+	return spawnOrigin + FVector(
+		stream.FRandRange(-spawnExtents.X, spawnExtents.X),
+		stream.FRandRange(-spawnExtents.Y, spawnExtents.Y),
+		stream.FRandRange(-spawnExtents.Z, spawnExtents.Z));
 
 }
 
 void ASpawnVolume::SetSpawningActive(bool bShouldSpawn) {
 
-	if(bShouldSpawn) {
-		//Set timer on spawn pickup
-		m_spawnDelay = FMath::FRandRange(spawnDelayMin, spawnDelayMax);
-		GetWorldTimerManager().SetTimer(spawnTimer, this, &ASpawnVolume::SpawnPickup, m_spawnDelay, false);
+	m_bSpawningActive = bShouldSpawn;
+	UpdateSpawnSchedule();
+
+}
+
+void ASpawnVolume::SetSignificance(eSpawnSignificance significance) {
+
+	if(significance == m_significance) {
+		return;
+	}
+
+	const bool bWasPaused = m_significance == eSpawnSignificance::ePaused;
+	m_significance = significance;
+
+	//Nobody is there to watch the pickups, stop sending them until a player comes back
+	const bool bPaused = significance == eSpawnSignificance::ePaused;
+	TArray<UPickupPool*> pools(m_typePools);
+	pools.Add(m_pickupPool);
+	for(UPickupPool* const pool : pools) {
+		if(pool) {
+			for(APickup* const pickup : pool->GetPickupsInUse()) {
+				if(pickup) {
+					pickup->SetUnwatched(bPaused);
+				}
+			}
+		}
+	}
+
+	//Throttling takes effect from the next roll, only pausing and resuming change the schedule now
+	if(bPaused != bWasPaused) {
+		UpdateSpawnSchedule();
+	}
+
+}
+
+void ASpawnVolume::UpdateSpawnSchedule() {
+
+	//The game mode schedules every volume's spawns in one place, volumes only run their own timer without it
+	FSpawnScheduler* const scheduler = GetSpawnScheduler();
+
+	if(m_bSpawningActive && m_significance != eSpawnSignificance::ePaused) {
+		//Coming back from a pause carries on with the delay that was left
+		m_spawnDelay = m_pausedSpawnDelay >= 0.0f ? m_pausedSpawnDelay : RollSpawnDelay();
+		m_pausedSpawnDelay = -1.0f;
+		if(scheduler) {
+			scheduler->Schedule(this, GetWorld()->GetTimeSeconds() + m_spawnDelay);
+		} else {
+			//Set timer on spawn pickup
+			GetWorldTimerManager().SetTimer(spawnTimer, this, &ASpawnVolume::OnSpawnTimer, m_spawnDelay, false);
+		}
 	} else {
+		//Pausing keeps what was left of the delay, switching spawning off forgets it
+		if(!m_bSpawningActive) {
+			m_pausedSpawnDelay = -1.0f;
+		} else {
+			float dueTime = 0.0f;
+			if(scheduler && scheduler->FindDueTime(this, dueTime)) {
+				m_pausedSpawnDelay = FMath::Max(dueTime - GetWorld()->GetTimeSeconds(), 0.0f);
+			} else if(GetWorldTimerManager().IsTimerActive(spawnTimer)) {
+				m_pausedSpawnDelay = GetWorldTimerManager().GetTimerRemaining(spawnTimer);
+			}
+		}
+
+		if(scheduler) {
+			scheduler->Cancel(this);
+		}
 		//Clear timer
 		GetWorldTimerManager().ClearTimer(spawnTimer);
 	}
 
 }
 
-void ASpawnVolume::SpawnPickup() {
+bool ASpawnVolume::SpawnPickup() {
+
+	BATTERY_SCOPE_CYCLE_COUNTER(SpawnPickup);
+
+	bool bSpawned = false;
 
-	//If we have set something to spawn
-	if(whatToSpawn != NULL) {
+	//If we have something to spawn - types that are still streaming in can't be spawned yet
+	UPickupPool* const pool = ChoosePool();
+	if(pool) {
 		//Check for valid world
 		UWorld* const world = GetWorld();
 
 		if(world) {
 
-			//Set the spawn parameters
-			FActorSpawnParameters spawnParams;
-			spawnParams.Owner = this;
-			spawnParams.Instigator = Instigator;
-
-			//Get a random location to spawn at
-			FVector spawnLocation = GetRandomPointInVolume();
+			//Get a random location to spawn at, checked clear of level geometry when the cache has one
+			FVector spawnLocation = DrawSpawnPoint();
 
 			//Get a random rotation
 			FRotator spawnRotation;
-			spawnRotation.Yaw = FMath::FRand() * 360.0f;
-			spawnRotation.Pitch = FMath::FRand() * 360.0f;
-			spawnRotation.Roll = FMath::FRand() * 360.0f;
-
-			//Spawn the pickup
-			APickup* const spawnedPickup = world->SpawnActor<APickup>(whatToSpawn, spawnLocation, spawnRotation, spawnParams);
+			spawnRotation.Yaw = m_randomStream.FRand() * 360.0f;
+			spawnRotation.Pitch = m_randomStream.FRand() * 360.0f;
+			spawnRotation.Roll = m_randomStream.FRand() * 360.0f;
 
-			m_spawnDelay = FMath::FRandRange(spawnDelayMin, spawnDelayMax);
-			GetWorldTimerManager().SetTimer(spawnTimer, this, &ASpawnVolume::SpawnPickup, m_spawnDelay, false);
+			//Take a pickup from the pool, it may refuse if it is fixed size and empty
+			APickup* const pickup = pool->Acquire(spawnLocation, spawnRotation);
+			if(pickup) {
+				FBatteryEventLog::LogSpawn(pickup);
+				ABatteryCollectorGameMode* const gameMode = world->GetAuthGameMode<ABatteryCollectorGameMode>();
+				if(gameMode) {
+					gameMode->RecordPickupSpawned();
+				}
+				bSpawned = true;
+			}
 
 		}
 
 	}
 
+	return bSpawned;
+
+}
+
+float ASpawnVolume::RollSpawnDelay() {
+	const float spawnDelay = m_randomStream.FRandRange(spawnDelayMin, spawnDelayMax);
+	return m_significance == eSpawnSignificance::eThrottled ? spawnDelay * throttledDelayScale : spawnDelay;
+}
+
+void ASpawnVolume::OnSpawnTimer() {
+
+	SpawnPickup();
+
+	m_spawnDelay = RollSpawnDelay();
+	GetWorldTimerManager().SetTimer(spawnTimer, this, &ASpawnVolume::OnSpawnTimer, m_spawnDelay, false);
+
+}
+
+FSpawnScheduler* ASpawnVolume::GetSpawnScheduler() const {
+
+	ABatteryCollectorGameMode* const gameMode = GetWorld() ? GetWorld()->GetAuthGameMode<ABatteryCollectorGameMode>() : nullptr;
+	return gameMode ? &gameMode->GetSpawnScheduler() : nullptr;
+
+}
+
+UPickupPool* ASpawnVolume::GetPoolAt(int32 index) const {
+	if(index == 0) {
+		return m_pickupPool;
+	}
+	return m_typePools.IsValidIndex(index - 1) ? m_typePools[index - 1] : nullptr;
+}
+
+int32 ASpawnVolume::FindPoolIndex(const UPickupPool* pool) const {
+	if(pool == nullptr) {
+		return INDEX_NONE;
+	}
+	if(pool == m_pickupPool) {
+		return 0;
+	}
+	const int32 typeIndex = m_typePools.IndexOfByKey(pool);
+	return typeIndex != INDEX_NONE ? typeIndex + 1 : INDEX_NONE;
 }
 
+void ASpawnVolume::DeactivatePickups() {
+	for(int32 iPool = 0; iPool < GetPoolCount(); iPool++) {
+		UPickupPool* const pool = GetPoolAt(iPool);
+		if(pool == nullptr) {
+			continue;
+		}
+
+		//Deactivating releases the pickup and takes it off the pool's list, so walk a copy
+		const TArray<APickup*> inUse(pool->GetPickupsInUse());
+		for(APickup* const pickup : inUse) {
+			if(pickup) {
+				pickup->SetActive(false);
+			}
+		}
+	}
+}
+
+FPickupPoolStats ASpawnVolume::GetPoolStats() const {
+	FPickupPoolStats stats = m_pickupPool ? m_pickupPool->GetStats() : FPickupPoolStats();
+
+	//Pickup type pools add up into one set of counters, the summed peak is an upper bound as pools peak at different times
+	for(const UPickupPool* const pool : m_typePools) {
+		if(pool) {
+			const FPickupPoolStats& poolStats = pool->GetStats();
+			stats.hits += poolStats.hits;
+			stats.misses += poolStats.misses;
+			stats.inUse += poolStats.inUse;
+			stats.peakInUse += poolStats.peakInUse;
+			stats.totalInstances += poolStats.totalInstances;
+		}
+	}
+	return stats;
+}
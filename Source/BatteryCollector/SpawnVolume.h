@@ -3,8 +3,52 @@
 #pragma once
 
 #include "GameFramework/Actor.h"
+#include "PickupPool.h"
 #include "SpawnVolume.generated.h"
 
+//How much a volume matters to the players right now, set by the game mode
+UENUM(BlueprintType)
+enum class eSpawnSignificance : uint8 {
+	//Near a player or in view, spawns at its normal rate
+	eFull,
+	//Out of the way, spawns at a fraction of its rate
+	eThrottled,
+	//Far from every player, doesn't spawn and its pickups stop replicating
+	ePaused
+};
+
+//How a volume's spawn point cache is doing
+USTRUCT(BlueprintType)
+struct FSpawnPointCacheStats {
+	GENERATED_BODY()
+
+	//Overlap queries run on candidate and re-checked points
+	UPROPERTY(BlueprintReadOnly, Category = "Spawning")
+	int32 tested;
+
+	//Queries that found level geometry in the way
+	UPROPERTY(BlueprintReadOnly, Category = "Spawning")
+	int32 rejected;
+
+	//Spawns that took a point from the cache
+	UPROPERTY(BlueprintReadOnly, Category = "Spawning")
+	int32 drawn;
+
+	//Spawns that found the cache empty and used an unchecked point
+	UPROPERTY(BlueprintReadOnly, Category = "Spawning")
+	int32 fallbacks;
+
+	//Checked points waiting to be used
+	UPROPERTY(BlueprintReadOnly, Category = "Spawning")
+	int32 cached;
+
+	//Seconds it took to fill the cache the first time, 0 until it has
+	UPROPERTY(BlueprintReadOnly, Category = "Spawning")
+	float buildSeconds;
+
+	FSpawnPointCacheStats() : tested(0), rejected(0), drawn(0), fallbacks(0), cached(0), buildSeconds(0.0f) {}
+};
+
 UCLASS()
 class BATTERYCOLLECTOR_API ASpawnVolume : public AActor
 {
@@ -18,6 +62,8 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 public:	
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
@@ -28,15 +74,64 @@ public:
 	UFUNCTION(BlueprintPure, Category = "Spawning")
 	FVector GetRandomPointInVolume();
 
+	//Take a point from the spawn point cache, or any point in the box if the cache is empty
+	FVector DrawSpawnPoint();
+
+	//Throw away cached points in the sphere and check new ones, for when the level changes around the volume
+	UFUNCTION(BlueprintCallable, Category = "Spawning")
+	void InvalidateSpawnPoints(FVector center, float radius);
+
+	//Spawn point cache counters
+	UFUNCTION(BlueprintPure, Category = "Spawning")
+	FSpawnPointCacheStats GetSpawnPointStats() const;
+
 	//Set whether we spawn batteries or not
 	UFUNCTION(BlueprintCallable, Category = "Spawning")
 	void SetSpawningActive(bool bShouldSpawn);
 
+	//Throttle or pause spawning while no player is near - a paused volume picks up where it left off when resumed
+	void SetSignificance(eSpawnSignificance significance);
+
+	UFUNCTION(BlueprintPure, Category = "Spawning")
+	FORCEINLINE eSpawnSignificance GetSignificance() const { return m_significance; }
+
+	//World space box pickups spawn in
+	FORCEINLINE FBox GetSpawnBounds() const { return m_whereToSpawn->Bounds.GetBox(); }
+
+	/**
+	 * Spawn one pickup now - called by the game mode's spawn scheduler when the volume is due
+	 * @return	False if the pool had nothing to give
+	 */
+	bool SpawnPickup();
+
+	//Seconds until the next spawn, drawn from the volume's stream
+	float RollSpawnDelay();
+
+	//Usage counters of this volume's pickup pool
+	UFUNCTION(BlueprintPure, Category = "Spawning")
+	FPickupPoolStats GetPoolStats() const;
+
+	//Pools by index - 0 is the whatToSpawn pool, the rest follow pickupTypes. Null where there is no pool (yet)
+	FORCEINLINE int32 GetPoolCount() const { return 1 + m_typePools.Num(); }
+	UPickupPool* GetPoolAt(int32 index) const;
+	int32 FindPoolIndex(const UPickupPool* pool) const;
+
+	//True while pickup types are streaming in and their pools don't exist yet
+	FORCEINLINE bool IsLoadingPickupTypes() const { return m_bLoadingPickupTypes; }
+
+	//Send every pickup this volume has in the level back to its pool
+	void DeactivatePickups();
+
 protected:
 	//The pickup to spawn
 	UPROPERTY(EditAnywhere, Category = "Spawning")
 	TSubclassOf<class APickup> whatToSpawn;
 
+	//Types to choose from by weight, streamed in when play begins. Replaces whatToSpawn when set
+	UPROPERTY(EditAnywhere, Category = "Spawning")
+	TArray<class UPickupTypeAsset*> pickupTypes;
+
+	//Only used when there is no game mode scheduling spawns
 	FTimerHandle spawnTimer;
 
 	//Min spawn delay
@@ -47,14 +142,136 @@ protected:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Spawning")
 	float spawnDelayMax;
 
+	//Spawn delays are this many times longer while the volume is throttled
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Spawning", meta = (ClampMin = "1.0"))
+	float throttledDelayScale;
+
+	//Seed for spawn locations, rotations and delays. 0 derives one from the session seed (-BatterySeed) or stays random
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Spawning")
+	int32 randomSeed;
+
+	//Pickups spawned up front when play begins
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Spawning|Pool", meta = (ClampMin = "0"))
+	int32 poolSize;
+
+	//Most pickups the pool may ever own, 0 for no limit
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Spawning|Pool", meta = (ClampMin = "0"))
+	int32 poolMaxSize;
+
+	//What to do when the pool runs dry
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Spawning|Pool")
+	ePickupPoolGrowth poolGrowth;
+
+	//Points checked free of level geometry kept ready for spawns, 0 to spawn anywhere in the box unchecked
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Spawning|Points", meta = (ClampMin = "0"))
+	int32 spawnPointCacheSize;
+
+	//Radius kept clear around a spawn point, 0 to use the bounds of the pickup's mesh
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Spawning|Points", meta = (ClampMin = "0.0"))
+	float spawnPointClearance;
+
+	//Most overlap queries the volume has in flight at once
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Spawning|Points", meta = (ClampMin = "1"))
+	int32 spawnPointQueriesPerFrame;
+
+	//Seconds between re-checks of cached points, 0 to never re-check
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Spawning|Points", meta = (ClampMin = "0.0"))
+	float spawnPointRefreshInterval;
+
+	//Cached points re-checked each refresh
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Spawning|Points", meta = (ClampMin = "1"))
+	int32 spawnPointsPerRefresh;
+
 private:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Spawning", meta = (AllowPrivateAccess = "true"))
 	UBoxComponent* m_whereToSpawn;
 
-	//Handles Pickup spawns
-	void SpawnPickup();
+	//Spawns on the volume's own timer and re-arms it
+	void OnSpawnTimer();
+
+	//The game mode's spawn scheduler, if there is one
+	class FSpawnScheduler* GetSpawnScheduler() const;
 
 	//Actual spawn delay
 	float m_spawnDelay;
+
+	//Spawning has been switched on, though it may be paused
+	bool m_bSpawningActive;
+
+	//Seconds that were left until the next spawn when the volume was paused, negative when there is nothing to resume
+	float m_pausedSpawnDelay;
+
+	eSpawnSignificance m_significance;
+
+	//Start or stop the scheduled spawn, as set by SetSpawningActive and the significance
+	void UpdateSpawnSchedule();
+
+	//Every random choice the volume makes comes from here so runs can be repeated
+	FRandomStream m_randomStream;
+
+	//Spawn point candidates and fallbacks. How many are drawn depends on when the async queries finish, so they have a
+	//stream of their own and leave m_randomStream to draw the same numbers for the same seed
+	FRandomStream m_spawnPointStream;
+
+	//Random point in the box from the given stream
+	FVector GetRandomPointFromStream(FRandomStream& stream) const;
+
+	//Recycles the pickups this volume spawns
+	UPROPERTY()
+	UPickupPool* m_pickupPool;
+
+	//One pool per entry in pickupTypes, null until that type has loaded
+	UPROPERTY()
+	TArray<UPickupPool*> m_typePools;
+
+	//Keeps the streamed pickup assets in memory while the volume uses them
+	UPROPERTY()
+	TArray<UObject*> m_loadedTypeAssets;
+
+	double m_typeLoadStart;
+
+	bool m_bLoadingPickupTypes;
+
+	//Stream in every pickup type's class, mesh and effect
+	void BeginLoadingPickupTypes();
+
+	//Give each loaded type its pool
+	void OnPickupTypesLoaded();
+
+	//Pool to spawn from next - the only pool, or a loaded type's picked by weight
+	UPickupPool* ChoosePool();
+
+	//Points known to be clear, filled by async overlap queries from Tick. Oldest checked first - draws and re-checks both
+	//take from the front and re-checked points go on the back, so every point is revisited in turn
+	TArray<FVector> m_spawnPoints;
+
+	//Cached points taken out to be checked again
+	TArray<FVector> m_spawnPointsToRecheck;
+
+	int32 m_spawnPointQueriesInFlight;
+
+	float m_spawnPointRadius;
+
+	//What the pickup collides as, only geometry that blocks it counts against a point
+	TEnumAsByte<ECollisionChannel> m_spawnPointChannel;
+
+	double m_spawnPointBuildStart;
+
+	FSpawnPointCacheStats m_spawnPointStats;
+
+	FOverlapDelegate m_spawnPointOverlapDelegate;
+
+	FTimerHandle m_spawnPointRefreshTimer;
+
+	//Work out the clearance for the pickup and start filling the cache
+	void BeginSpawnPointCache(TSubclassOf<class APickup> pickupClass, class UStaticMesh* meshOverride);
+
+	//Keep the volume ticking while there are queries to send
+	void UpdateSpawnPointTick();
+
+	void OnSpawnPointOverlap(const FTraceHandle& handle, FOverlapDatum& datum);
+
+	//Move the next few cached points onto the re-check list
+	void RecheckSpawnPoints();
 	
 };
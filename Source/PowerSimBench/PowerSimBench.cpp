@@ -0,0 +1,96 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+/**
+ * Steps the match's power rules for large numbers of players outside the engine, for tuning the balance and watching
+ * the cost per player. Not part of the game build - on Linux:
+ *
+ *   g++ -O3 -march=native -std=c++11 -I../BatteryCollector PowerSimBench.cpp -o PowerSimBench
+ *   ./PowerSimBench [players] [seconds] [collectsPerStep]
+ *
+ * With no arguments it runs 1k to 4M players for two simulated minutes each.
+ */
+
+#include "BatteryPowerSim.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace BatteryPowerSim;
+
+namespace {
+	//Power of a battery, as ABatteryPickup
+	const float BatteryPower = 150.0f;
+
+	//Same sequence every run, so runs can be compared
+	struct FXorShift {
+		uint32_t state;
+
+		explicit FXorShift(uint32_t seed) : state(seed) {}
+
+		uint32_t Next() {
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return state;
+		}
+	};
+
+	void RunBench(int32_t players, float seconds, double collectsPerStep) {
+
+		FPowerSimulation simulation;
+		simulation.Reserve(players);
+		for(int32_t iPlayer = 0; iPlayer < players; iPlayer++) {
+			simulation.Add();
+		}
+
+		const FPowerRules& rules = simulation.GetRules();
+		const int32_t steps = (int32_t)(seconds / rules.stepSeconds + 0.5f);
+		const int32_t collects = (int32_t)std::ceil(collectsPerStep * players);
+		FXorShift random(1);
+
+		double stepSeconds = 0.0;
+		const auto start = std::chrono::steady_clock::now();
+		for(int32_t iStep = 0; iStep < steps; iStep++) {
+			//Player 0 never collects, it is checked against the decay worked out on demand below
+			for(int32_t iCollect = 0; iCollect < collects && players > 1; iCollect++) {
+				simulation.Collect(1 + (int32_t)(random.Next() % (uint32_t)(players - 1)), BatteryPower);
+			}
+
+			const auto stepStart = std::chrono::steady_clock::now();
+			simulation.Step();
+			stepSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - stepStart).count();
+		}
+		const double totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		//Stepping has to agree with the game, which works the power out from the time instead
+		const float expected = PowerAt(rules.initialPower, 0.0f, DecayPerSecond(rules.decayRate, rules.initialPower), steps * rules.stepSeconds);
+		const float drift = std::fabs(simulation.GetPower(0) - expected);
+
+		printf("%9d players, %5d steps: %8.3f ms/step, %8.1f M player-steps/s (%.1f M with collects), %d won, %d lost, %d playing, drift %.4f\n",
+			players, steps, stepSeconds * 1000.0 / steps, players * (double)steps / stepSeconds / 1.0e6, players * (double)steps / totalSeconds / 1.0e6,
+			simulation.Count(ePlayerPowerState::eWon), simulation.Count(ePlayerPowerState::eLost), simulation.Count(ePlayerPowerState::ePlaying), drift);
+
+	}
+}
+
+int main(int argc, char** argv) {
+
+	const float seconds = argc > 2 ? (float)atof(argv[2]) : 120.0f;
+	//About one battery per player every eight seconds
+	const double collectsPerStep = argc > 3 ? atof(argv[3]) : 0.002;
+
+	if(argc > 1) {
+		RunBench(atoi(argv[1]), seconds, collectsPerStep);
+		return 0;
+	}
+
+	const int32_t playerCounts[] = { 1000, 10000, 100000, 1000000, 4000000 };
+	for(const int32_t players : playerCounts) {
+		RunBench(players, seconds, collectsPerStep);
+	}
+
+	return 0;
+
+}